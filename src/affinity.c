@@ -0,0 +1,198 @@
+/*
+ * affinity.c
+ * which warehouses each worker thread works on
+ *
+ * Remote warehouses (the 1% remote New-Order lines, the 15% remote
+ * Payments) are still drawn over all warehouses; the policy only
+ * decides the home warehouse of each transaction.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "affinity.h"
+
+int affinity_policy = AFF_UNIFORM;
+static int num_partitions = 1;
+static int num_nodes = -1;
+
+/* number of NUMA nodes from sysfs, 1 if there is no such information */
+static int numa_nodes(void)
+{
+	char path[64];
+	int n = 0;
+	FILE *f;
+
+	for (;;) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d/cpulist", n);
+		f = fopen(path, "r");
+		if (f == NULL)
+			break;
+		fclose(f);
+		n++;
+	}
+	return n ? n : 1;
+}
+
+/* policy[:n], e.g. "uniform", "home", "partition:4", "numa" */
+int affinity_parse(const char *spec)
+{
+	const char *arg = strchr(spec, ':');
+	size_t len = arg ? (size_t)(arg - spec) : strlen(spec);
+
+	if (len == 7 && strncmp(spec, "uniform", len) == 0) {
+		affinity_policy = AFF_UNIFORM;
+	} else if (len == 4 && strncmp(spec, "home", len) == 0) {
+		affinity_policy = AFF_HOME;
+	} else if (len == 9 && strncmp(spec, "partition", len) == 0) {
+		affinity_policy = AFF_PARTITION;
+		num_partitions = arg ? atoi(arg + 1) : 0;
+		if (num_partitions < 1)
+			return 1;
+	} else if (len == 4 && strncmp(spec, "numa", len) == 0) {
+		affinity_policy = AFF_NUMA;
+	} else {
+		return 1;
+	}
+	return 0;
+}
+
+const char *affinity_name(void)
+{
+	static char buf[32];
+
+	switch (affinity_policy) {
+	case AFF_HOME:
+		return "home";
+	case AFF_PARTITION:
+		snprintf(buf, sizeof(buf), "partition:%d", num_partitions);
+		return buf;
+	case AFF_NUMA:
+		return "numa";
+	}
+	return "uniform";
+}
+
+int affinity_num_groups(int nthreads, int nware)
+{
+	int n;
+
+	switch (affinity_policy) {
+	case AFF_HOME:
+		return nthreads < nware ? nthreads : nware;
+	case AFF_PARTITION:
+		n = num_partitions;
+		break;
+	case AFF_NUMA:
+		if (num_nodes < 0)
+			num_nodes = numa_nodes();
+		n = num_nodes;
+		break;
+	default:
+		return 1;
+	}
+	/* never more groups than threads or warehouses */
+	if (n > nthreads)
+		n = nthreads;
+	if (n > nware)
+		n = nware;
+	return n;
+}
+
+void affinity_assign(affinity_t *a, int t_num, int nthreads, int nware)
+{
+	int groups = affinity_num_groups(nthreads, nware);
+	int g;
+
+	a->node = -1;
+	switch (affinity_policy) {
+	case AFF_HOME:
+		/*
+		 * thread t lives on warehouse t % nware + 1, or on a
+		 * contiguous range of them when there are fewer threads
+		 * than warehouses, so every warehouse is driven
+		 */
+		g = t_num % groups;
+		a->rank = t_num / groups;
+		a->group_size = nthreads / groups + (g < nthreads % groups);
+		break;
+	case AFF_NUMA:
+		/* round-robin over the nodes, so groups stay balanced */
+		g = t_num % groups;
+		a->node = g;
+		a->rank = t_num / groups;
+		a->group_size = nthreads / groups + (g < nthreads % groups);
+		break;
+	case AFF_PARTITION:
+		/* contiguous thread blocks */
+		g = (long)t_num * groups / nthreads;
+		a->rank = t_num - (g * nthreads + groups - 1) / groups;
+		a->group_size = ((g + 1) * nthreads + groups - 1) / groups -
+				(g * nthreads + groups - 1) / groups;
+		break;
+	default:
+		a->group = 0;
+		a->w_lo = 1;
+		a->w_hi = nware;
+		a->rank = t_num;
+		a->group_size = nthreads;
+		return;
+	}
+	a->group = g;
+	a->w_lo = 1 + (long)nware * g / groups;
+	a->w_hi = (long)nware * (g + 1) / groups;
+}
+
+/* parse a sysfs cpulist ("0-3,8-11") into set */
+static int read_cpulist(int node, cpu_set_t *set)
+{
+	char path[64], buf[1024], *p, *end;
+	long lo, hi;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+		 node);
+	f = fopen(path, "r");
+	if (f == NULL)
+		return 1;
+	if (fgets(buf, sizeof(buf), f) == NULL) {
+		fclose(f);
+		return 1;
+	}
+	fclose(f);
+
+	CPU_ZERO(set);
+	for (p = buf; *p && *p != '\n';) {
+		lo = hi = strtol(p, &end, 10);
+		if (end == p)
+			break;
+		if (*end == '-')
+			hi = strtol(end + 1, &end, 10);
+		for (; lo <= hi; lo++)
+			CPU_SET(lo, set);
+		p = *end == ',' ? end + 1 : end;
+	}
+	return CPU_COUNT(set) == 0;
+}
+
+/* called by the worker itself: pin it to its node's CPUs */
+int affinity_bind(const affinity_t *a)
+{
+	cpu_set_t set;
+	unsigned int cpu, node;
+
+	if (a->node < 0)
+		return 0;
+	if (read_cpulist(a->node, &set))
+		return 0; /* no sysfs topology: a single node */
+	if (sched_setaffinity(0, sizeof(set), &set))
+		return 1;
+	/* sanity check where we landed */
+	if (getcpu(&cpu, &node) == 0 && (int)node != a->node)
+		return 1;
+	return 0;
+}
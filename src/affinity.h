@@ -0,0 +1,33 @@
+/*
+ * affinity.h
+ * which warehouses each worker thread works on
+ */
+
+#ifndef _TPCC_AFFINITY_H_
+#define _TPCC_AFFINITY_H_
+
+enum affinity_policy {
+	AFF_UNIFORM, /* every thread, every warehouse */
+	AFF_HOME, /* one home warehouse (range, if -c < -w) per thread */
+	AFF_PARTITION, /* contiguous warehouse ranges per thread group */
+	AFF_NUMA /* one range per NUMA node, threads bound to the node */
+};
+
+typedef struct affinity {
+	int w_lo; /* home warehouses, inclusive */
+	int w_hi;
+	int group; /* threads of a group share w_lo..w_hi */
+	int rank; /* index of the thread within its group */
+	int group_size;
+	int node; /* AFF_NUMA: node to bind to, else -1 */
+} affinity_t;
+
+extern int affinity_policy;
+
+int affinity_parse(const char *spec);
+const char *affinity_name(void);
+int affinity_num_groups(int nthreads, int nware);
+void affinity_assign(affinity_t *a, int t_num, int nthreads, int nware);
+int affinity_bind(const affinity_t *a);
+
+#endif
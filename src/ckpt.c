@@ -0,0 +1,277 @@
+/*
+ * ckpt.c
+ * background WAL checkpointer
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "ckpt.h"
+#include "main.h"
+#include "shard.h"
+#include "profile.h"
+#include "counters.h"
+
+int ckpt_on = 0;
+
+static int ckpt_mode = SQLITE_CHECKPOINT_PASSIVE;
+static int ckpt_frames = 1000; /* 0: no frames trigger */
+static long ckpt_interval_ms = 0; /* 0: no timer */
+
+static const char *mode_name[] = { "passive", "full", "restart", "truncate" };
+
+static pthread_t ckpt_pth;
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int requested; /* a commit crossed ckpt_frames */
+static int stopping;
+static unsigned generation; /* odd while checkpointing */
+
+/* main, then shard<k> */
+#define MAX_SCHEMAS 128
+
+/* WAL frames already backfilled by the last checkpoint, per schema */
+static int backfilled[MAX_SCHEMAS];
+
+/* written by the checkpointer only, read by the reporter */
+static uint64_t n_runs, n_busy, frames_done, usec_total, usec_max;
+static uint64_t prev_runs, prev_frames, prev_usec; /* reporter only */
+
+/* mode[,frames=N][,interval=msec] */
+int ckpt_parse(const char *spec)
+{
+	char buf[128], *item, *save;
+	int i, found;
+
+	if (strlen(spec) >= sizeof(buf))
+		return 1;
+	strcpy(buf, spec);
+	for (item = strtok_r(buf, ",", &save); item;
+	     item = strtok_r(NULL, ",", &save)) {
+		if (strncmp(item, "frames=", 7) == 0) {
+			ckpt_frames = atoi(item + 7);
+			if (ckpt_frames < 0)
+				return 1;
+			continue;
+		}
+		if (strncmp(item, "interval=", 9) == 0) {
+			ckpt_interval_ms = atol(item + 9);
+			if (ckpt_interval_ms < 0)
+				return 1;
+			continue;
+		}
+		for (i = 0, found = 0; i < 4; i++) {
+			if (strcmp(item, mode_name[i]) == 0) {
+				ckpt_mode = i; /* SQLITE_CHECKPOINT_* order */
+				found = 1;
+			}
+		}
+		if (!found)
+			return 1;
+	}
+	if (ckpt_frames == 0 && ckpt_interval_ms == 0)
+		return 1;
+	ckpt_on = 1;
+	return 0;
+}
+
+const char *ckpt_describe(void)
+{
+	static char buf[96];
+	int n;
+
+	n = snprintf(buf, sizeof(buf), "%s", mode_name[ckpt_mode]);
+	if (ckpt_frames)
+		n += snprintf(buf + n, sizeof(buf) - n, ", at %d frames",
+			      ckpt_frames);
+	if (ckpt_interval_ms)
+		snprintf(buf + n, sizeof(buf) - n, ", every %ld msec.",
+			 ckpt_interval_ms);
+	return buf;
+}
+
+static int schema_index(const char *schema)
+{
+	int k;
+
+	if (strncmp(schema, "shard", 5) != 0)
+		return 0;
+	k = atoi(schema + 5) + 1;
+	return k < MAX_SCHEMAS ? k : MAX_SCHEMAS - 1;
+}
+
+/*
+ * runs in the committing worker: only a wakeup, never the checkpoint.
+ * counts the frames not backfilled yet, so a WAL that a PASSIVE
+ * checkpoint could not restart does not trigger on every commit.
+ */
+static int wal_hook(void *p, sqlite3 *db, const char *schema, int frames)
+{
+	int base = __atomic_load_n(&backfilled[schema_index(schema)],
+				   __ATOMIC_RELAXED);
+
+	if (frames < base) /* the WAL restarted */
+		base = 0;
+	if (ckpt_frames && frames - base >= ckpt_frames &&
+	    !__atomic_load_n(&requested, __ATOMIC_RELAXED)) {
+		pthread_mutex_lock(&mtx);
+		requested = 1;
+		pthread_cond_signal(&cond);
+		pthread_mutex_unlock(&mtx);
+	}
+	return SQLITE_OK;
+}
+
+void ckpt_install(sqlite3 *db)
+{
+	if (ckpt_on)
+		sqlite3_wal_hook(db, wal_hook, NULL);
+}
+
+/* checkpoint main and every attached shard */
+static void checkpoint_all(sqlite3 *db)
+{
+	const char *schema;
+	int k, idx, rc, log, done, prev;
+	double t0;
+	uint64_t us;
+
+	for (k = 0; (schema = sqlite3_db_name(db, k)) != NULL; k++) {
+		if (strcmp(schema, "temp") == 0)
+			continue;
+		t0 = clock_sec(CLOCK_MONOTONIC);
+		rc = sqlite3_wal_checkpoint_v2(db, schema, ckpt_mode, &log,
+					       &done);
+		us = (uint64_t)((clock_sec(CLOCK_MONOTONIC) - t0) * 1e6);
+		counter_add(&n_runs, 1);
+		counter_add(&usec_total, us);
+		if (us > usec_max)
+			__atomic_store_n(&usec_max, us, __ATOMIC_RELAXED);
+		if (rc == SQLITE_BUSY)
+			counter_add(&n_busy, 1);
+		else if (rc != SQLITE_OK)
+			printf("%s: %s: error: %s\n", __func__, schema,
+			       sqlite3_errmsg(db));
+		/* done counts from the start of the WAL, as does backfilled */
+		idx = schema_index(schema);
+		prev = backfilled[idx];
+		if (done >= 0) {
+			counter_add(&frames_done,
+				    done >= prev ? done - prev : done);
+			__atomic_store_n(&backfilled[idx], done,
+					 __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static void *ckpt_main(void *p)
+{
+	sqlite3 *db = p;
+	struct timespec deadline;
+	int timed_out;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	pthread_mutex_lock(&mtx);
+	while (!stopping) {
+		timed_out = 0;
+		if (ckpt_interval_ms) {
+			deadline.tv_sec += ckpt_interval_ms / 1000;
+			deadline.tv_nsec += (ckpt_interval_ms % 1000) * 1000000;
+			if (deadline.tv_nsec >= 1000000000) {
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000;
+			}
+		}
+		while (!requested && !stopping && !timed_out) {
+			if (ckpt_interval_ms)
+				timed_out = pthread_cond_timedwait(
+						    &cond, &mtx, &deadline) ==
+					    ETIMEDOUT;
+			else
+				pthread_cond_wait(&cond, &mtx);
+		}
+		if (stopping)
+			break;
+		requested = 0;
+		pthread_mutex_unlock(&mtx);
+		__atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+		checkpoint_all(db);
+		__atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+		pthread_mutex_lock(&mtx);
+		/* a timer tick that came late starts over from now */
+		if (ckpt_interval_ms && !timed_out)
+			clock_gettime(CLOCK_REALTIME, &deadline);
+	}
+	pthread_mutex_unlock(&mtx);
+	sqlite3_close(db);
+	return NULL;
+}
+
+/*
+ * bumped when a checkpoint starts and when it ends: a tx that saw g0
+ * at its start and g1 at its end overlapped one if g0 is odd or g0 != g1
+ */
+unsigned ckpt_generation(void)
+{
+	return __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+}
+
+/* open the checkpointer's connection and start it */
+int ckpt_start(const char *dbpath)
+{
+	sqlite3 *db = NULL;
+
+	if (sqlite3_open(dbpath, &db) != SQLITE_OK ||
+	    shard_attach(db, dbpath) || profile_apply(db, 0)) {
+		printf("%s: error: %s\n", __func__,
+		       db ? sqlite3_errmsg(db) : "open failed");
+		sqlite3_close(db);
+		return 1;
+	}
+	/* FULL and up wait for writers and readers through it */
+	sqlite3_busy_timeout(db, 1000);
+	return pthread_create(&ckpt_pth, NULL, ckpt_main, db) != 0;
+}
+
+void ckpt_stop(void)
+{
+	pthread_mutex_lock(&mtx);
+	stopping = 1;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&mtx);
+	pthread_join(ckpt_pth, NULL);
+}
+
+/* checkpoints since the last interval; nothing when none */
+void ckpt_interval(void)
+{
+	uint64_t runs = counter_read(&n_runs);
+	uint64_t frames = counter_read(&frames_done);
+	uint64_t us = counter_read(&usec_total);
+
+	if (runs == prev_runs)
+		return;
+	printf("      checkpoints: %lu, %lu frames, %.3f msec.\n",
+	       runs - prev_runs, frames - prev_frames,
+	       (us - prev_usec) / 1000.0);
+	prev_runs = runs;
+	prev_frames = frames;
+	prev_usec = us;
+}
+
+void ckpt_report(void)
+{
+	uint64_t runs = counter_read(&n_runs);
+
+	printf("\n<Checkpoints> (whole run)\n");
+	printf("  %s: runs: %lu, busy: %lu, frames: %lu\n", ckpt_describe(),
+	       runs, counter_read(&n_busy), counter_read(&frames_done));
+	printf("  time: %.3f sec., avg: %.3f msec., max: %.3f msec.\n",
+	       counter_read(&usec_total) / 1e6,
+	       runs ? counter_read(&usec_total) / 1000.0 / runs : 0.0,
+	       counter_read(&usec_max) / 1000.0);
+}
@@ -0,0 +1,28 @@
+/*
+ * ckpt.h
+ * background WAL checkpointer
+ *
+ * With -C the connections of the workers do not checkpoint on commit
+ * (their wal_hook replaces wal_autocheckpoint). A checkpointer thread
+ * with a connection of its own checkpoints main and every shard instead,
+ * when a commit leaves a WAL of at least frames pages and/or every
+ * interval msec., in the PASSIVE, FULL, RESTART or TRUNCATE mode.
+ */
+
+#ifndef _TPCC_CKPT_H_
+#define _TPCC_CKPT_H_
+
+#include <sqlite3.h>
+
+extern int ckpt_on;
+
+int ckpt_parse(const char *spec);
+const char *ckpt_describe(void);
+void ckpt_install(sqlite3 *db);
+int ckpt_start(const char *dbpath);
+void ckpt_stop(void);
+unsigned ckpt_generation(void);
+void ckpt_interval(void);
+void ckpt_report(void);
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * cost.c
+ * cache and I/O cost of each transaction type
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cost.h"
+#include "counters.h"
+#include "iovfs.h"
+
+extern const char *tx_name[];
+
+typedef struct {
+	uint64_t n[TX_NUMS][COST_NUMS];
+} __attribute__((aligned(CACHE_LINE_SIZE))) cost_shard_t;
+
+static cost_shard_t *shards;
+static int num_shards;
+
+int cost_init(int nthreads)
+{
+	shards = aligned_alloc(CACHE_LINE_SIZE,
+			       sizeof(cost_shard_t) * nthreads);
+	if (shards == NULL)
+		return 1;
+	memset(shards, 0, sizeof(cost_shard_t) * nthreads);
+	num_shards = nthreads;
+	return 0;
+}
+
+void cost_done(void)
+{
+	free(shards);
+	shards = NULL;
+	num_shards = 0;
+}
+
+/* read one db_status counter and start it over */
+static int db_stat(sqlite3 *db, int op, int hiwater)
+{
+	int cur = 0, hi = 0;
+
+	sqlite3_db_status(db, op, &cur, &hi, 1);
+	return hiwater ? hi : cur;
+}
+
+/* the connection the attempt runs on must be in arg->ctx by now */
+void cost_begin(thread_arg *arg, cost_snap_t *snap)
+{
+	sqlite3 *db = arg->ctx;
+
+	db_stat(db, SQLITE_DBSTATUS_CACHE_HIT, 0);
+	db_stat(db, SQLITE_DBSTATUS_CACHE_MISS, 0);
+	db_stat(db, SQLITE_DBSTATUS_CACHE_WRITE, 0);
+	db_stat(db, SQLITE_DBSTATUS_CACHE_SPILL, 0);
+	db_stat(db, SQLITE_DBSTATUS_LOOKASIDE_HIT, 1);
+	db_stat(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, 1);
+	db_stat(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL, 1);
+	iovfs_thread_io(snap->io);
+}
+
+/* only attempts that end inside the measurement window are counted */
+void cost_end(thread_arg *arg, int tx, cost_snap_t *snap)
+{
+	uint64_t *n = shards[arg->number].n[tx];
+	sqlite3 *db = arg->ctx;
+	uint64_t io[3];
+
+	if (get_phase() != PHASE_MEASURE)
+		return;
+	counter_add(&n[COST_CACHE_HIT],
+		    db_stat(db, SQLITE_DBSTATUS_CACHE_HIT, 0));
+	counter_add(&n[COST_CACHE_MISS],
+		    db_stat(db, SQLITE_DBSTATUS_CACHE_MISS, 0));
+	counter_add(&n[COST_CACHE_WRITE],
+		    db_stat(db, SQLITE_DBSTATUS_CACHE_WRITE, 0));
+	counter_add(&n[COST_CACHE_SPILL],
+		    db_stat(db, SQLITE_DBSTATUS_CACHE_SPILL, 0));
+	counter_add(&n[COST_LOOKASIDE_HIT],
+		    db_stat(db, SQLITE_DBSTATUS_LOOKASIDE_HIT, 1));
+	counter_add(&n[COST_LOOKASIDE_MISS],
+		    db_stat(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, 1) +
+			    db_stat(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL,
+				    1));
+	iovfs_thread_io(io);
+	counter_add(&n[COST_READ_BYTES], io[0] - snap->io[0]);
+	counter_add(&n[COST_WRITE_BYTES], io[1] - snap->io[1]);
+	counter_add(&n[COST_SYNCS], io[2] - snap->io[2]);
+}
+
+/* per completed (on time or late) tx of each type, all attempts included */
+void cost_report(all_tx_stat_t *stats)
+{
+	uint64_t sum[COST_NUMS], done;
+	int t, tx, m;
+
+	printf("\n<Transaction Cost> (per completed tx, retries included)\n");
+	printf("  %-12s %9s %9s %9s %7s %9s %7s", "tx", "cache_hit",
+	       "pages_rd", "pages_wr", "spill", "lookaside", "la_miss");
+	if (iovfs_on)
+		printf(" %9s %9s %7s", "KB_read", "KB_write", "syncs");
+	printf("\n");
+	for (tx = 0; tx < TX_NUMS; tx++) {
+		memset(sum, 0, sizeof(sum));
+		for (t = 0; t < num_shards; t++)
+			for (m = 0; m < COST_NUMS; m++)
+				sum[m] += counter_read(&shards[t].n[tx][m]);
+		done = stats->stat[tx].success + stats->stat[tx].late;
+		if (done == 0)
+			continue;
+		printf("  %-12s %9.1f %9.2f %9.2f %7.2f %9.1f %7.2f",
+		       tx_name[tx], (double)sum[COST_CACHE_HIT] / done,
+		       (double)sum[COST_CACHE_MISS] / done,
+		       (double)sum[COST_CACHE_WRITE] / done,
+		       (double)sum[COST_CACHE_SPILL] / done,
+		       (double)sum[COST_LOOKASIDE_HIT] / done,
+		       (double)sum[COST_LOOKASIDE_MISS] / done);
+		if (iovfs_on)
+			printf(" %9.2f %9.2f %7.3f",
+			       sum[COST_READ_BYTES] / 1024.0 / done,
+			       sum[COST_WRITE_BYTES] / 1024.0 / done,
+			       (double)sum[COST_SYNCS] / done);
+		printf("\n");
+	}
+}
@@ -0,0 +1,41 @@
+/*
+ * cost.h
+ * cache and I/O cost of each transaction type
+ *
+ * Every attempt reads the sqlite3_db_status() counters of the
+ * connection it ran on (reset at its start, so pooled connections are
+ * fine) and, with -V, the bytes and syncs the thread did through the
+ * counting VFS. The deltas go to per-thread shards by tx type and are
+ * reported per completed tx, so a throughput change can be told to be
+ * CPU or I/O.
+ */
+
+#ifndef _TPCC_COST_H_
+#define _TPCC_COST_H_
+
+#include "main.h"
+
+enum cost_metric {
+	COST_CACHE_HIT,
+	COST_CACHE_MISS, /* pages read */
+	COST_CACHE_WRITE, /* pages written */
+	COST_CACHE_SPILL,
+	COST_LOOKASIDE_HIT,
+	COST_LOOKASIDE_MISS,
+	COST_READ_BYTES, /* through the counting VFS */
+	COST_WRITE_BYTES,
+	COST_SYNCS,
+	COST_NUMS
+};
+
+typedef struct {
+	uint64_t io[3]; /* VFS bytes read, written, syncs at the start */
+} cost_snap_t;
+
+int cost_init(int nthreads);
+void cost_done(void);
+void cost_begin(thread_arg *arg, cost_snap_t *snap);
+void cost_end(thread_arg *arg, int tx, cost_snap_t *snap);
+void cost_report(all_tx_stat_t *stats);
+
+#endif
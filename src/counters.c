@@ -0,0 +1,53 @@
+/*
+ * counters.c
+ * per-thread transaction counters
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "counters.h"
+
+static tx_counters_t *shards;
+static int num_shards;
+
+int counters_init(int nthreads)
+{
+	shards = aligned_alloc(CACHE_LINE_SIZE,
+			       sizeof(tx_counters_t) * nthreads);
+	if (shards == NULL)
+		return 1;
+	memset(shards, 0, sizeof(tx_counters_t) * nthreads);
+	num_shards = nthreads;
+	return 0;
+}
+
+tx_counters_t *counters_get(int t_num)
+{
+	return &shards[t_num];
+}
+
+/* sum all shards into *sum (g_stats is only ever filled from here) */
+void counters_collect(all_tx_stat_t *sum)
+{
+	int t, tx;
+
+	memset(sum, 0, sizeof(*sum));
+	for (t = 0; t < num_shards; t++) {
+		for (tx = 0; tx < TX_NUMS; tx++) {
+			tx_stat_t *st = &shards[t].stats.stat[tx];
+
+			sum->stat[tx].success += counter_read(&st->success);
+			sum->stat[tx].late += counter_read(&st->late);
+			sum->stat[tx].retry += counter_read(&st->retry);
+			sum->stat[tx].failure += counter_read(&st->failure);
+		}
+	}
+}
+
+void counters_done(void)
+{
+	free(shards);
+	shards = NULL;
+	num_shards = 0;
+}
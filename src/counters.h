@@ -0,0 +1,41 @@
+/*
+ * counters.h
+ * per-thread transaction counters
+ */
+
+#ifndef _TPCC_COUNTERS_H_
+#define _TPCC_COUNTERS_H_
+
+#include <stdint.h>
+
+#include "main.h"
+
+/*
+ * One shard per worker thread, padded to its own cache lines so that
+ * workers never write to a line another worker or the reporter owns.
+ */
+typedef struct tx_counters {
+	all_tx_stat_t stats;
+} __attribute__((aligned(CACHE_LINE_SIZE))) tx_counters_t;
+
+int counters_init(int nthreads);
+tx_counters_t *counters_get(int t_num);
+void counters_collect(all_tx_stat_t *sum);
+void counters_done(void);
+
+/*
+ * Only the owning thread writes a shard, so a relaxed load/store pair is
+ * enough; the reporter reads it with relaxed loads in counters_collect().
+ */
+static inline void counter_add(uint64_t *c, int64_t delta)
+{
+	__atomic_store_n(c, __atomic_load_n(c, __ATOMIC_RELAXED) + delta,
+			 __ATOMIC_RELAXED);
+}
+
+static inline uint64_t counter_read(uint64_t *c)
+{
+	return __atomic_load_n(c, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -13,6 +13,9 @@
 #include "spt_proc.h"
 #include "tpc.h"
 #include "main.h"
+#include "lockwait.h"
+#include "errstat.h"
+#include "txphase.h"
 
 int delivery(int t_num, thread_arg *arg, int w_id_arg, int o_carrier_id_arg)
 {
@@ -39,16 +42,17 @@ int delivery(int t_num, thread_arg *arg, int w_id_arg, int o_carrier_id_arg)
 
 	for (d_id = 1; d_id <= DIST_PER_WARE; d_id++) {
 		proceed = 1;
+		txphase_mark(arg, TXP_DL_NEWORDER);
 		/*EXEC_SQL SELECT COALESCE(MIN(no_o_id),0) INTO :no_o_id
 		                FROM new_orders
 		                WHERE no_d_id = :d_id AND no_w_id = :w_id;*/
 
-		sqlite_stmt = arg->stmt[25];
+		sqlite_stmt = STMT(arg, 25, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, d_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, w_id);
 
-		ret = sqlite3_step(sqlite_stmt);
+		ret = tx_step(arg, sqlite_stmt);
 		if (ret != SQLITE_DONE) {
 			if (ret != SQLITE_ROW)
 				goto sqlerr;
@@ -66,28 +70,29 @@ int delivery(int t_num, thread_arg *arg, int w_id_arg, int o_carrier_id_arg)
 		proceed = 2;
 		/*EXEC_SQL DELETE FROM new_orders WHERE no_o_id = :no_o_id AND no_d_id = :d_id
 		  AND no_w_id = :w_id;*/
-		sqlite_stmt = arg->stmt[26];
+		sqlite_stmt = STMT(arg, 26, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, no_o_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, d_id);
 		sqlite3_bind_int64(sqlite_stmt, 3, w_id);
 
-		if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+		if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 			goto sqlerr;
 
 		sqlite3_reset(sqlite_stmt);
 
 		proceed = 3;
+		txphase_mark(arg, TXP_DL_ORDER);
 		/*EXEC_SQL SELECT o_c_id INTO :c_id FROM orders
 		                WHERE o_id = :no_o_id AND o_d_id = :d_id
 				AND o_w_id = :w_id;*/
-		sqlite_stmt = arg->stmt[27];
+		sqlite_stmt = STMT(arg, 27, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, no_o_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, d_id);
 		sqlite3_bind_int64(sqlite_stmt, 3, w_id);
 
-		ret = sqlite3_step(sqlite_stmt);
+		ret = tx_step(arg, sqlite_stmt);
 		if (ret != SQLITE_DONE) {
 			if (ret != SQLITE_ROW)
 				goto sqlerr;
@@ -104,31 +109,32 @@ int delivery(int t_num, thread_arg *arg, int w_id_arg, int o_carrier_id_arg)
 		/*EXEC_SQL UPDATE orders SET o_carrier_id = :o_carrier_id
 		                WHERE o_id = :no_o_id AND o_d_id = :d_id AND
 				o_w_id = :w_id;*/
-		sqlite_stmt = arg->stmt[28];
+		sqlite_stmt = STMT(arg, 28, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, o_carrier_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, no_o_id);
 		sqlite3_bind_int64(sqlite_stmt, 3, d_id);
 		sqlite3_bind_int64(sqlite_stmt, 4, w_id);
 
-		if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+		if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 			goto sqlerr;
 
 		sqlite3_reset(sqlite_stmt);
 
 		proceed = 5;
+		txphase_mark(arg, TXP_DL_LINES);
 		/*EXEC_SQL UPDATE order_line
 		                SET ol_delivery_d = :datetime
 		                WHERE ol_o_id = :no_o_id AND ol_d_id = :d_id AND
 				ol_w_id = :w_id;*/
-		sqlite_stmt = arg->stmt[29];
+		sqlite_stmt = STMT(arg, 29, w_id);
 
 		sqlite3_bind_text(sqlite_stmt, 1, datetime, -1, SQLITE_STATIC);
 		sqlite3_bind_int64(sqlite_stmt, 2, no_o_id);
 		sqlite3_bind_int64(sqlite_stmt, 3, d_id);
 		sqlite3_bind_int64(sqlite_stmt, 4, w_id);
 
-		if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+		if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 			goto sqlerr;
 
 		sqlite3_reset(sqlite_stmt);
@@ -138,13 +144,13 @@ int delivery(int t_num, thread_arg *arg, int w_id_arg, int o_carrier_id_arg)
 		                FROM order_line
 		                WHERE ol_o_id = :no_o_id AND ol_d_id = :d_id
 				AND ol_w_id = :w_id;*/
-		sqlite_stmt = arg->stmt[30];
+		sqlite_stmt = STMT(arg, 30, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, no_o_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, d_id);
 		sqlite3_bind_int64(sqlite_stmt, 3, w_id);
 
-		ret = sqlite3_step(sqlite_stmt);
+		ret = tx_step(arg, sqlite_stmt);
 		if (ret != SQLITE_DONE) {
 			if (ret != SQLITE_ROW)
 				goto sqlerr;
@@ -158,18 +164,19 @@ int delivery(int t_num, thread_arg *arg, int w_id_arg, int o_carrier_id_arg)
 		sqlite3_reset(sqlite_stmt);
 
 		proceed = 7;
+		txphase_mark(arg, TXP_DL_CUSTOMER);
 		/*EXEC_SQL UPDATE customer SET c_balance = c_balance + :ol_total ,
 		                             c_delivery_cnt = c_delivery_cnt + 1
 		                WHERE c_id = :c_id AND c_d_id = :d_id AND
 				c_w_id = :w_id;*/
-		sqlite_stmt = arg->stmt[31];
+		sqlite_stmt = STMT(arg, 31, w_id);
 
 		sqlite3_bind_double(sqlite_stmt, 1, ol_total);
 		sqlite3_bind_int64(sqlite_stmt, 2, c_id);
 		sqlite3_bind_int64(sqlite_stmt, 3, d_id);
 		sqlite3_bind_int64(sqlite_stmt, 4, w_id);
 
-		if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+		if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 			goto sqlerr;
 
 		sqlite3_reset(sqlite_stmt);
@@ -183,13 +190,12 @@ int delivery(int t_num, thread_arg *arg, int w_id_arg, int o_carrier_id_arg)
 	return (1);
 
 sqlerr:
-	fprintf(stderr, "delivery %d:%d\n", t_num, proceed);
-	printf("%s: error: %s\n", __func__, sqlite3_errmsg(arg->ctx));
+	tx_error(arg, TX_DELIVERY, proceed);
 
 	//error(ctx[t_num],mysql_stmt);
 	/*EXEC SQL WHENEVER SQLERROR GOTO sqlerrerr;*/
 	/*EXEC_SQL ROLLBACK WORK;*/
-	sqlite3_exec(arg->ctx, "ROLLBACK;", NULL, NULL, NULL);
+	/* the caller rolls back */
 sqlerrerr:
 	return (0);
 }
@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/times.h>
 #include <time.h>
 #include "tpc.h" /* prototypes for misc. functions */
@@ -15,30 +16,25 @@
 #include <sqlite3.h>
 
 #include "main.h"
+#include "counters.h"
+#include "lockwait.h"
+#include "gcommit.h"
+#include "remote.h"
+#include "rpool.h"
+#include "errstat.h"
+#include "cost.h"
+#include "txphase.h"
+#include "slowlog.h"
 
-static int other_ware(int home_ware);
-static int do_neword(int t_num, thread_arg *arg);
-static int do_payment(int t_num, thread_arg *arg);
-static int do_ordstat(int t_num, thread_arg *arg);
-static int do_delivery(int t_num, thread_arg *arg);
-static int do_slev(int t_num, thread_arg *arg);
 
 extern sqlite3 **ctx;
 extern int num_ware;
 extern int num_conn;
-extern int activate_transaction;
-extern int counting_on;
-extern int time_start;
-extern int time_end;
-extern int num_trans;
 
 extern int num_node;
 extern int time_count;
 extern FILE *freport_file;
 
-extern double max_rt[];
-extern double total_rt[];
-
 extern int rt_limit[];
 
 extern long clk_tck;
@@ -46,48 +42,228 @@ extern sb_percentile_t local_percentile;
 
 #define MAX_RETRY 2000
 
+/*
+ * BEGIN flavour per tx type. the writers take the write lock up front,
+ * so they never fail upgrading a read lock half way through. with
+ * shards tx_begin() turns IMMEDIATE into DEFERRED plus the write locks
+ * of the shards the attempt writes; EXCLUSIVE is refused there.
+ */
+int begin_mode[TX_NUMS] = {
+	CTL_IMMEDIATE, /* New-Order */
+	CTL_IMMEDIATE, /* Payment */
+	CTL_DEFERRED, /* Order-Status */
+	CTL_IMMEDIATE, /* Delivery */
+	CTL_DEFERRED, /* Stock-Level */
+};
+
+/* tx types that write, and so queue for the write lock with -L */
+static const int tx_writes[TX_NUMS] = { 1, 1, 0, 1, 0 };
+
+static const char *ctl_sql[CTL_NUMS] = {
+	"BEGIN DEFERRED;", "BEGIN IMMEDIATE;", "BEGIN EXCLUSIVE;",
+	"COMMIT;", "ROLLBACK;",
+	"SAVEPOINT tx;", "ROLLBACK TO tx;", "RELEASE tx;",
+};
+
+static const char *mode_names[] = { "deferred", "immediate", "exclusive" };
+static const char *tx_short_names[TX_NUMS] = { "neword", "payment", "ordstat",
+					       "delivery", "slev" };
+
+static int lookup(const char *s, size_t len, const char **names, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (strlen(names[i]) == len && strncmp(names[i], s, len) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * -b: comma separated "mode" (all writers) or "tx=mode" items, e.g.
+ * "exclusive" or "neword=exclusive,slev=immediate"
+ */
+int begin_mode_parse(const char *spec)
+{
+	const char *p = spec, *end, *eq;
+	int tx, mode;
+
+	while (*p) {
+		end = strchr(p, ',');
+		if (end == NULL)
+			end = p + strlen(p);
+		eq = memchr(p, '=', end - p);
+		if (eq == NULL) {
+			mode = lookup(p, end - p, mode_names, 3);
+			if (mode < 0)
+				return 1;
+			begin_mode[TX_NEWORD] = begin_mode[TX_PAYMENT] =
+				begin_mode[TX_DELIVERY] = mode;
+		} else {
+			tx = lookup(p, eq - p, tx_short_names, TX_NUMS);
+			mode = lookup(eq + 1, end - eq - 1, mode_names, 3);
+			if (tx < 0 || mode < 0)
+				return 1;
+			begin_mode[tx] = mode;
+		}
+		p = *end ? end + 1 : end;
+	}
+	return 0;
+}
+
+const char *begin_mode_name(int mode)
+{
+	return mode_names[mode];
+}
+
+int tx_ctl_prepare(thread_arg *arg)
+{
+	char *sql;
+	int i, k, rc;
+
+	for (i = 0; i < CTL_NUMS; i++) {
+		if (sqlite3_prepare_v2(arg->ctx, ctl_sql[i], -1, &arg->ctl[i],
+				       NULL) != SQLITE_OK)
+			return 1;
+	}
+	arg->wlock = NULL;
+	if (num_db_shards == 0 || sqlite3_db_readonly(arg->ctx, "main") == 1)
+		return 0;
+	arg->wlock = calloc(shard_sets(), sizeof(sqlite3_stmt *));
+	if (arg->wlock == NULL)
+		return 1;
+	for (k = 0; k < shard_sets(); k++) {
+		/* shared-nothing: only the thread's own shard is attached */
+		if (shared_nothing && k != arg->number)
+			continue;
+		/* a write that changes nothing, but takes the lock */
+		sql = sqlite3_mprintf("UPDATE shard%d.warehouse SET w_id = w_id "
+				      "WHERE 0;", k);
+		rc = sqlite3_prepare_v2(arg->ctx, sql, -1, &arg->wlock[k],
+					NULL);
+		sqlite3_free(sql);
+		if (rc != SQLITE_OK)
+			return 1;
+	}
+	return 0;
+}
+
+void tx_ctl_finalize(thread_arg *arg)
+{
+	int i;
+
+	for (i = 0; i < CTL_NUMS; i++) {
+		sqlite3_finalize(arg->ctl[i]);
+		arg->ctl[i] = NULL;
+	}
+	if (arg->wlock) {
+		for (i = 0; i < shard_sets(); i++)
+			sqlite3_finalize(arg->wlock[i]);
+		free(arg->wlock);
+		arg->wlock = NULL;
+	}
+}
+
+/* run one transaction control statement, returns the sqlite result */
+int tx_ctl(thread_arg *arg, int ctl)
+{
+	int rc;
+
+	rc = sqlite3_step(arg->ctl[ctl]);
+	sqlite3_reset(arg->ctl[ctl]);
+	return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+/*
+ * the shards a tx writes, ascending and without duplicates, into ks
+ * (room for MAX_NUM_ITEMS + 1). returns their number.
+ */
+int tx_write_shards(const tx_input_t *in, int *ks)
+{
+	int i, j, k, m, n = 0;
+
+	ks[n++] = shard_of(in->w_id);
+	if (in->tx == TX_NEWORD) {
+		for (i = 0; i < in->neword.ol_cnt; i++)
+			ks[n++] = shard_of(in->neword.supware[i]);
+	} else if (in->tx == TX_PAYMENT) {
+		ks[n++] = shard_of(in->payment.c_w_id);
+	}
+	/* insertion sort, dropping duplicates; ks[0..m) is sorted */
+	for (i = 1, m = 1; i < n; i++) {
+		k = ks[i];
+		for (j = m; j > 0 && ks[j - 1] > k; j--)
+			;
+		if (j > 0 && ks[j - 1] == k)
+			continue;
+		memmove(&ks[j + 1], &ks[j], (m - j) * sizeof(int));
+		ks[j] = k;
+		m++;
+	}
+	return m;
+}
+
+/*
+ * abort the statements a failing tx left in progress, or the next
+ * COMMIT on the connection fails with "SQL statements in progress"
+ */
+void tx_abort_stmts(sqlite3 *db)
+{
+	sqlite3_stmt *s = NULL;
+
+	while ((s = sqlite3_next_stmt(db, s)) != NULL) {
+		if (sqlite3_stmt_busy(s))
+			sqlite3_reset(s);
+	}
+}
+
+/* only transactions finished inside the measurement window are counted */
+static inline int measuring(void)
+{
+	return get_phase() == PHASE_MEASURE;
+}
+
 static inline void inc_success(enum tx_type tx, thread_arg *arg)
 {
-	g_stats.stat[tx].success++;
-	arg->stats.stat[tx].success++;
+	counter_add(&arg->counters->stats.stat[tx].success, 1);
 }
 
 static inline void inc_late(enum tx_type tx, thread_arg *arg)
 {
-	g_stats.stat[tx].late++;
-	arg->stats.stat[tx].late++;
+	counter_add(&arg->counters->stats.stat[tx].late, 1);
 }
 
 static inline void inc_retry(enum tx_type tx, thread_arg *arg)
 {
-	g_stats.stat[tx].retry++;
-	arg->stats.stat[tx].retry++;
+	counter_add(&arg->counters->stats.stat[tx].retry, 1);
 }
 
 static inline void inc_failure(enum tx_type tx, thread_arg *arg)
 {
-	g_stats.stat[tx].retry--;
-	arg->stats.stat[tx].retry--;
-	g_stats.stat[tx].failure++;
-	arg->stats.stat[tx].failure++;
+	counter_add(&arg->counters->stats.stat[tx].retry, -1);
+	counter_add(&arg->counters->stats.stat[tx].failure, 1);
 }
 
 static void update_on_success(enum tx_type tx, thread_arg *arg,
 			      struct timespec *tbuf1,
 			      struct timespec *tbuf2)
 {
-	double rt = (double)(tbuf2->tv_sec * 1000.0 +
+	double rt;
+
+	/* open loop / terminals: charge the time spent behind schedule too */
+	if (arg->scheduled)
+		tbuf1 = &arg->intended;
+
+	rt = (double)(tbuf2->tv_sec * 1000.0 +
 			     tbuf2->tv_nsec / 1000000.0 -
 			     tbuf1->tv_sec * 1000.0 -
 			     tbuf1->tv_nsec / 1000000.0);
 	//printf("NOT : %.3f\n", rt);
 
-	if (rt > max_rt[tx])
-		max_rt[tx] = rt;
-	total_rt[tx] += rt;
-	sb_percentile_update(&local_percentile, rt);
-	hist_inc(tx, rt);
-	if (counting_on) {
+	sb_percentile_update(&local_percentile, arg->number, rt);
+	hist_inc(arg->number, tx, rt);
+	if (measuring()) {
 		if (rt < rt_limit[tx]) {
 			inc_success(tx, arg);
 		} else {
@@ -97,333 +273,321 @@ static void update_on_success(enum tx_type tx, thread_arg *arg,
 }
 
 
-int driver(int t_num, thread_arg *arg)
+/*
+ * pick the warehouse a tx runs against: the terminal's home one, or a
+ * random one out of the thread's affinity range
+ */
+static int pick_w_id(thread_arg *arg, int home_w_id)
 {
-	int i, j;
-	instrumentation_type neword_time, payment_time, ordstat_time,
-		delivery_time, slev_time;
-	/* Actually, WaitTimes are needed... */
+	if (home_w_id)
+		return home_w_id;
+	if (arg->aff.w_lo == arg->aff.w_hi)
+		return arg->aff.w_lo;
+	return RandomNumber(&arg->rnd, arg->aff.w_lo, arg->aff.w_hi);
+}
 
-	switch (seq_get()) {
-	case 0:
-		START_TIMING(neword_t, neword_time);
-		do_neword(t_num, arg);
-		END_TIMING(neword_t, neword_time);
-		break;
-	case 1:
-		START_TIMING(payment_t, payment_time);
-		do_payment(t_num, arg);
-		END_TIMING(payment_t, payment_time);
-		break;
-	case 2:
-		START_TIMING(ordstat_t, ordstat_time);
-		do_ordstat(t_num, arg);
-		END_TIMING(ordstat_t, ordstat_time);
-		break;
-	case 3:
-		START_TIMING(delivery_t, delivery_time);
-		do_delivery(t_num, arg);
-		END_TIMING(delivery_t, delivery_time);
-		break;
-	case 4:
-		START_TIMING(slev_t, slev_time);
-		do_slev(t_num, arg);
-		END_TIMING(slev_t, slev_time);
-		break;
-	default:
-		printf("Error - Unknown sequence.\n");
-	}
+/*
+ * produce the id of a valid warehouse other than home_ware
+ * (assuming there is one)
+ */
+static int other_ware(rnd_ctx_t *rnd, int home_ware)
+{
+	int tmp;
 
-	return (0);
+	if (num_ware == 1)
+		return home_ware;
+	while ((tmp = RandomNumber(rnd, 1, num_ware)) == home_ware)
+		;
+	return tmp;
 }
 
 /*
- * prepare data and execute the new order transaction for one order
+ * prepare data for the new order transaction for one order
  * officially, this is supposed to be simulated terminal I/O
  */
-static int do_neword(int t_num, thread_arg *arg)
+static void gen_neword(rnd_ctx_t *rnd, tx_input_t *in)
 {
-	int c_num;
-	int i, ret;
-	clock_t clk1, clk2;
-	double rt;
-	struct timespec tbuf1;
-	struct timespec tbuf2;
-	int w_id, d_id, c_id, ol_cnt;
-	int all_local = 1;
+	int i;
 	int notfound =
 		MAXITEMS + 1; /* valid item ids are numbered consecutively
 				    [1..MAXITEMS] */
 	int rbk;
-	int itemid[MAX_NUM_ITEMS];
-	int supware[MAX_NUM_ITEMS];
-	int qty[MAX_NUM_ITEMS];
 
-	if (num_node == 0) {
-		w_id = RandomNumber(1, num_ware);
-	} else {
-		c_num = ((num_node * t_num) / num_conn); /* drop moduls */
-		w_id = RandomNumber(1 + (num_ware * c_num) / num_node,
-				    (num_ware * (c_num + 1)) / num_node);
-	}
-	d_id = RandomNumber(1, DIST_PER_WARE);
-	c_id = NURand(1023, 1, CUST_PER_DIST);
+	in->d_id = RandomNumber(rnd, 1, DIST_PER_WARE);
+	in->neword.c_id = NURand(rnd, 1023, 1, CUST_PER_DIST);
 
-	ol_cnt = RandomNumber(5, 15);
-	rbk = RandomNumber(1, 100);
+	in->neword.ol_cnt = RandomNumber(rnd, 5, 15);
+	rbk = RandomNumber(rnd, 1, 100);
 
-	for (i = 0; i < ol_cnt; i++) {
-		itemid[i] = NURand(8191, 1, MAXITEMS);
-		if ((i == ol_cnt - 1) && (rbk == 1)) {
-			itemid[i] = notfound;
+	in->neword.all_local = 1;
+	for (i = 0; i < in->neword.ol_cnt; i++) {
+		in->neword.itemid[i] = NURand(rnd, 8191, 1, MAXITEMS);
+		if ((i == in->neword.ol_cnt - 1) && (rbk == 1)) {
+			in->neword.itemid[i] = notfound;
 		}
-		if (RandomNumber(1, 100) != 1) {
-			supware[i] = w_id;
+		if (RandomNumber(rnd, 1, 100) != 1) {
+			in->neword.supware[i] = in->w_id;
 		} else {
-			supware[i] = other_ware(w_id);
-			all_local = 0;
+			in->neword.supware[i] = other_ware(rnd, in->w_id);
+			in->neword.all_local = 0;
 		}
-		qty[i] = RandomNumber(1, 10);
+		in->neword.qty[i] = RandomNumber(rnd, 1, 10);
 	}
-
-	clk1 = clock_gettime(CLOCK_MONOTONIC, &tbuf1);
-	for (i = 0; i < MAX_RETRY; i++) {
-		ret = neword(t_num, arg, w_id, d_id, c_id, ol_cnt, all_local, itemid,
-			     supware, qty);
-		clk2 = clock_gettime(CLOCK_MONOTONIC, &tbuf2);
-
-		if (ret) {
-			update_on_success(0, arg, &tbuf1, &tbuf2);
-			return (1); /* end */
-		} else {
-			if (counting_on) {
-				inc_retry(0, arg);
-			}
-		}
-	}
-
-	if (counting_on) {
-		inc_failure(0, arg);
-	}
-
-	return (0);
 }
 
 /*
- * produce the id of a valid warehouse other than home_ware
- * (assuming there is one)
+ * prepare data for the payment transaction
  */
-static int other_ware(int home_ware)
+static void gen_payment(rnd_ctx_t *rnd, tx_input_t *in)
 {
-	int tmp;
-
-	if (num_ware == 1)
-		return home_ware;
-	while ((tmp = RandomNumber(1, num_ware)) == home_ware)
-		;
-	return tmp;
+	in->d_id = RandomNumber(rnd, 1, DIST_PER_WARE);
+	in->payment.c_id = NURand(rnd, 1023, 1, CUST_PER_DIST);
+	Lastname(NURand(rnd, 255, 0, 999), in->payment.c_last);
+	in->payment.h_amount = RandomNumber(rnd, 1, 5000);
+	if (RandomNumber(rnd, 1, 100) <= 60) {
+		in->payment.byname = 1; /* select by last name */
+	} else {
+		in->payment.byname = 0; /* select by customer id */
+	}
+	if (RandomNumber(rnd, 1, 100) <= 85) {
+		in->payment.c_w_id = in->w_id;
+		in->payment.c_d_id = in->d_id;
+	} else {
+		in->payment.c_w_id = other_ware(rnd, in->w_id);
+		in->payment.c_d_id = RandomNumber(rnd, 1, DIST_PER_WARE);
+	}
 }
 
 /*
- * prepare data and execute payment transaction
+ * prepare data for the order status transaction
  */
-static int do_payment(int t_num, thread_arg *arg)
+static void gen_ordstat(rnd_ctx_t *rnd, tx_input_t *in)
 {
-	int c_num;
-	int byname, i, ret;
-	clock_t clk1, clk2;
-	double rt;
-	struct timespec tbuf1;
-	struct timespec tbuf2;
-	int w_id, d_id, c_w_id, c_d_id, c_id, h_amount;
-	char c_last[17];
-
-	if (num_node == 0) {
-		w_id = RandomNumber(1, num_ware);
-	} else {
-		c_num = ((num_node * t_num) / num_conn); /* drop moduls */
-		w_id = RandomNumber(1 + (num_ware * c_num) / num_node,
-				    (num_ware * (c_num + 1)) / num_node);
-	}
-	d_id = RandomNumber(1, DIST_PER_WARE);
-	c_id = NURand(1023, 1, CUST_PER_DIST);
-	Lastname(NURand(255, 0, 999), c_last);
-	h_amount = RandomNumber(1, 5000);
-	if (RandomNumber(1, 100) <= 60) {
-		byname = 1; /* select by last name */
-	} else {
-		byname = 0; /* select by customer id */
-	}
-	if (RandomNumber(1, 100) <= 85) {
-		c_w_id = w_id;
-		c_d_id = d_id;
+	in->d_id = RandomNumber(rnd, 1, DIST_PER_WARE);
+	in->ordstat.c_id = NURand(rnd, 1023, 1, CUST_PER_DIST);
+	Lastname(NURand(rnd, 255, 0, 999), in->ordstat.c_last);
+	if (RandomNumber(rnd, 1, 100) <= 60) {
+		in->ordstat.byname = 1; /* select by last name */
 	} else {
-		c_w_id = other_ware(w_id);
-		c_d_id = RandomNumber(1, DIST_PER_WARE);
-	}
-
-	clk1 = clock_gettime(CLOCK_MONOTONIC, &tbuf1);
-	for (i = 0; i < MAX_RETRY; i++) {
-		ret = payment(t_num, arg, w_id, d_id, byname, c_w_id, c_d_id, c_id,
-			      c_last, h_amount);
-		clk2 = clock_gettime(CLOCK_MONOTONIC, &tbuf2);
-
-		if (ret) {
-			update_on_success(1, arg, &tbuf1, &tbuf2);
-
-			return (1); /* end */
-		} else {
-			if (counting_on) {
-				inc_retry(1, arg);
-			}
-		}
-	}
-
-	if (counting_on) {
-		inc_failure(1, arg);
+		in->ordstat.byname = 0; /* select by customer id */
 	}
-
-	return (0);
 }
 
 /*
- * prepare data and execute order status transaction
+ * prepare data for the delivery transaction
  */
-static int do_ordstat(int t_num, thread_arg *arg)
+static void gen_delivery(rnd_ctx_t *rnd, tx_input_t *in)
 {
-	int c_num;
-	int byname, i, ret;
-	clock_t clk1, clk2;
-	double rt;
-	struct timespec tbuf1;
-	struct timespec tbuf2;
-	int w_id, d_id, c_id;
-	char c_last[16];
+	in->delivery.o_carrier_id = RandomNumber(rnd, 1, 10);
+}
 
-	if (num_node == 0) {
-		w_id = RandomNumber(1, num_ware);
-	} else {
-		c_num = ((num_node * t_num) / num_conn); /* drop moduls */
-		w_id = RandomNumber(1 + (num_ware * c_num) / num_node,
-				    (num_ware * (c_num + 1)) / num_node);
-	}
-	d_id = RandomNumber(1, DIST_PER_WARE);
-	c_id = NURand(1023, 1, CUST_PER_DIST);
-	Lastname(NURand(255, 0, 999), c_last);
-	if (RandomNumber(1, 100) <= 60) {
-		byname = 1; /* select by last name */
-	} else {
-		byname = 0; /* select by customer id */
-	}
+/*
+ * prepare data for the stock level transaction
+ */
+static void gen_slev(rnd_ctx_t *rnd, tx_input_t *in, int home_d_id)
+{
+	/* 2.8.1.1: a terminal always reports on its own district */
+	in->d_id = home_d_id ? home_d_id : RandomNumber(rnd, 1, DIST_PER_WARE);
+	in->slev.level = RandomNumber(rnd, 10, 20);
+}
 
-	clk1 = clock_gettime(CLOCK_MONOTONIC, &tbuf1);
-	for (i = 0; i < MAX_RETRY; i++) {
-		ret = ordstat(t_num, arg, w_id, d_id, byname, c_id, c_last);
-		clk2 = clock_gettime(CLOCK_MONOTONIC, &tbuf2);
+/*
+ * fill in the input of one tx (home_w_id/home_d_id: the terminal's,
+ * 0 for a random warehouse/district)
+ */
+void tx_input_gen(thread_arg *arg, int t_num, int tx, int home_w_id,
+		  int home_d_id, tx_input_t *in)
+{
+	rnd_ctx_t *rnd = &arg->rnd;
 
-		if (ret) {
-			update_on_success(2, arg, &tbuf1, &tbuf2);
+	in->tx = tx;
+	in->w_id = pick_w_id(arg, home_w_id);
+	in->d_id = 0;
 
-			return (1); /* end */
-		} else {
-			if (counting_on) {
-				inc_retry(2, arg);
-			}
-		}
+	switch (tx) {
+	case 0:
+		gen_neword(rnd, in);
+		break;
+	case 1:
+		gen_payment(rnd, in);
+		break;
+	case 2:
+		gen_ordstat(rnd, in);
+		break;
+	case 3:
+		gen_delivery(rnd, in);
+		break;
+	case 4:
+		gen_slev(rnd, in, home_d_id);
+		break;
+	default:
+		printf("Error - Unknown sequence.\n");
 	}
+}
 
-	if (counting_on) {
-		inc_failure(2, arg);
+/* the tx function for in, without BEGIN/COMMIT */
+int tx_run(int t_num, thread_arg *arg, tx_input_t *in)
+{
+	switch (in->tx) {
+	case 0:
+		return neword(t_num, arg, in->w_id, in->d_id, in->neword.c_id,
+			      in->neword.ol_cnt, in->neword.all_local,
+			      in->neword.itemid, in->neword.supware,
+			      in->neword.qty);
+	case 1:
+		return payment(t_num, arg, in->w_id, in->d_id,
+			       in->payment.byname, in->payment.c_w_id,
+			       in->payment.c_d_id, in->payment.c_id,
+			       in->payment.c_last, in->payment.h_amount);
+	case 2:
+		return ordstat(t_num, arg, in->w_id, in->d_id,
+			       in->ordstat.byname, in->ordstat.c_id,
+			       in->ordstat.c_last);
+	case 3:
+		return delivery(t_num, arg, in->w_id,
+				in->delivery.o_carrier_id);
+	case 4:
+		return slev(t_num, arg, in->w_id, in->d_id, in->slev.level);
 	}
-
-	return (0);
+	return 0;
 }
 
 /*
- * execute delivery transaction
+ * BEGIN of a tx. BEGIN IMMEDIATE takes the write lock of every attached
+ * schema, the shared main file (item) included, so with shards all the
+ * writers would queue on it. A writer begins DEFERRED instead and takes
+ * the write locks of just the shards it writes, in ascending order so
+ * two txs cannot wait for each other.
  */
-static int do_delivery(int t_num, thread_arg *arg)
+static int tx_begin(thread_arg *arg, const tx_input_t *in, int mode)
 {
-	int c_num;
-	int i, ret;
-	clock_t clk1, clk2;
-	double rt;
-	struct timespec tbuf1;
-	struct timespec tbuf2;
-	int w_id, o_carrier_id;
-
-	if (num_node == 0) {
-		w_id = RandomNumber(1, num_ware);
-	} else {
-		c_num = ((num_node * t_num) / num_conn); /* drop moduls */
-		w_id = RandomNumber(1 + (num_ware * c_num) / num_node,
-				    (num_ware * (c_num + 1)) / num_node);
+	int ks[MAX_NUM_ITEMS + 1];
+	int i, n, rc;
+
+	if (mode == CTL_DEFERRED || arg->wlock == NULL)
+		return tx_ctl(arg, mode);
+	rc = tx_ctl(arg, CTL_DEFERRED);
+	n = tx_write_shards(in, ks);
+	for (i = 0; i < n && rc == SQLITE_OK; i++) {
+		/* shared-nothing: the other shards' parts were shipped */
+		if (arg->wlock[ks[i]] == NULL)
+			continue;
+		rc = sqlite3_step(arg->wlock[ks[i]]);
+		sqlite3_reset(arg->wlock[ks[i]]);
+		if (rc == SQLITE_DONE)
+			rc = SQLITE_OK;
 	}
-	o_carrier_id = RandomNumber(1, 10);
-
-	clk1 = clock_gettime(CLOCK_MONOTONIC, &tbuf1);
-	for (i = 0; i < MAX_RETRY; i++) {
-		ret = delivery(t_num, arg, w_id, o_carrier_id);
-		clk2 = clock_gettime(CLOCK_MONOTONIC, &tbuf2);
+	return rc;
+}
 
-		if (ret) {
-			update_on_success(3, arg, &tbuf1, &tbuf2);
-			return (1); /* end */
+/*
+ * one attempt on the worker's own connection, or on a pooled read-only
+ * one for Order-Status and Stock-Level when there is a pool
+ */
+static int tx_attempt(int t_num, thread_arg *arg, tx_input_t *in, int admit)
+{
+	int pooled = ro_pool_size > 0 && !tx_writes[in->tx];
+	int ks[MAX_NUM_ITEMS + 1], nks = 0;
+	ro_conn_t save;
+	cost_snap_t snap;
+	int ret;
+
+	if (pooled)
+		ro_pool_enter(arg, &save);
+	cost_begin(arg, &snap);
+	txphase_begin(arg, in->tx);
+	if (admit) {
+		/* queue for every shard the tx writes, the way tx_begin() locks */
+		if (arg->remote) {
+			/* shared-nothing: the other shards' parts were shipped */
+			ks[0] = shard_of(in->w_id);
+			nks = 1;
 		} else {
-			if (counting_on) {
-				inc_retry(3, arg);
-			}
+			nks = tx_write_shards(in, ks);
 		}
+		admission_enter(arg, ks, nks);
 	}
-
-	if (counting_on) {
-		inc_failure(3, arg);
+	/* a read-only connection cannot take the write lock */
+	ret = 0;
+	if (tx_begin(arg, in, pooled ? CTL_DEFERRED : begin_mode[in->tx]) !=
+	    SQLITE_OK)
+		tx_error(arg, in->tx, ERR_PHASE_CTL);
+	else if (tx_run(t_num, arg, in)) {
+		txphase_mark(arg, TXP_COMMIT);
+		ret = tx_ctl(arg, CTL_COMMIT) == SQLITE_OK;
+		if (!ret)
+			tx_error(arg, in->tx, ERR_PHASE_CTL);
 	}
-
-	return (0);
+	/* the tx functions leave rolling back to us */
+	if (!ret) {
+		tx_abort_stmts(arg->ctx);
+		if (!sqlite3_get_autocommit(arg->ctx))
+			tx_ctl(arg, CTL_ROLLBACK);
+	}
+	txphase_end(arg, ret);
+	if (admit)
+		admission_leave(ks, nks);
+	cost_end(arg, in->tx, &snap);
+	if (pooled)
+		ro_pool_leave(arg, &save);
+	return ret;
 }
 
 /*
- * prepare data and execute the stock level transaction
+ * run one prepared tx to completion, retrying up to MAX_RETRY times
  */
-static int do_slev(int t_num, thread_arg *arg)
+int tx_execute(int t_num, thread_arg *arg, tx_input_t *in)
 {
-	int c_num;
+	enum tx_type tx = in->tx;
 	int i, ret;
-	clock_t clk1, clk2;
-	double rt;
+	int admit = writer_admission && tx_writes[tx];
+	int grouped = group_commit && tx_writes[tx];
+	instrumentation_type tx_time;
 	struct timespec tbuf1;
 	struct timespec tbuf2;
-	int w_id, d_id, level;
-
-	if (num_node == 0) {
-		w_id = RandomNumber(1, num_ware);
-	} else {
-		c_num = ((num_node * t_num) / num_conn); /* drop moduls */
-		w_id = RandomNumber(1 + (num_ware * c_num) / num_node,
-				    (num_ware * (c_num + 1)) / num_node);
-	}
-	d_id = RandomNumber(1, DIST_PER_WARE);
-	level = RandomNumber(10, 20);
-
-	clk1 = clock_gettime(CLOCK_MONOTONIC, &tbuf1);
+	slow_snap_t slow;
+
+	START_TIMING(neword_t + tx, tx_time);
+	if (slowlog_on)
+		slowlog_begin(arg, &slow);
+	clock_gettime(CLOCK_MONOTONIC, &tbuf1);
+	if (arg->remote)
+		remote_prepare(t_num, arg, in);
 	for (i = 0; i < MAX_RETRY; i++) {
-		ret = slev(t_num, arg, w_id, d_id, level);
-		clk2 = clock_gettime(CLOCK_MONOTONIC, &tbuf2);
+		/*
+		 * each attempt is a transaction of its own, after the parts
+		 * on other threads' warehouses
+		 */
+		if (arg->remote && remote_ship(t_num, arg))
+			ret = 0;
+		else if (grouped)
+			ret = gcommit_submit(arg, in);
+		else
+			ret = tx_attempt(t_num, arg, in, admit);
+		clock_gettime(CLOCK_MONOTONIC, &tbuf2);
 
 		if (ret) {
-			update_on_success(4, arg, &tbuf1, &tbuf2);
+			update_on_success(tx, arg, &tbuf1, &tbuf2);
+			if (slowlog_on)
+				slowlog_end(arg, &slow, in, &tbuf1, &tbuf2,
+					    i + 1, 1);
+			END_TIMING(neword_t + tx, tx_time);
 			return (1); /* end */
 		} else {
-			if (counting_on) {
-				inc_retry(4, arg);
+			if (measuring()) {
+				inc_retry(tx, arg);
 			}
 		}
 	}
 
-	if (counting_on) {
-		inc_failure(4, arg);
+	if (measuring()) {
+		inc_failure(tx, arg);
 	}
+	if (arg->remote)
+		remote_abandon(arg);
+	if (slowlog_on)
+		slowlog_end(arg, &slow, in, &tbuf1, &tbuf2, MAX_RETRY, 0);
+	END_TIMING(neword_t + tx, tx_time);
 
 	return (0);
 }
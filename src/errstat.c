@@ -0,0 +1,170 @@
+/*
+ * errstat.c
+ * failed statements, counted by tx, phase and sqlite result code
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "errstat.h"
+#include "counters.h"
+
+/* seconds between two messages of one thread */
+#define ERR_LOG_INTERVAL 1.0
+
+extern const char *tx_name[];
+
+typedef struct {
+	uint64_t n[TX_NUMS][ERR_PHASES][ERRC_NUMS];
+	double next_log; /* CLOCK_MONOTONIC sec. */
+	uint64_t suppressed;
+} __attribute__((aligned(CACHE_LINE_SIZE))) err_shard_t;
+
+static const char *errc_name[ERRC_NUMS] = {
+	"BUSY", "BUSY_SNAPSHOT", "BUSY_RECOVERY", "LOCKED",
+	"CONSTRAINT", "IOERR", "NODATA", "OTHER",
+};
+
+static err_shard_t *shards;
+static int num_shards;
+static uint64_t prev[ERRC_NUMS]; /* reporter only */
+
+int errstat_init(int nthreads)
+{
+	shards = aligned_alloc(CACHE_LINE_SIZE,
+			       sizeof(err_shard_t) * nthreads);
+	if (shards == NULL)
+		return 1;
+	memset(shards, 0, sizeof(err_shard_t) * nthreads);
+	num_shards = nthreads;
+	return 0;
+}
+
+void errstat_done(void)
+{
+	free(shards);
+	shards = NULL;
+	num_shards = 0;
+}
+
+static int err_class(int rc)
+{
+	switch (rc) {
+	case SQLITE_BUSY:
+		return ERRC_BUSY;
+	case SQLITE_BUSY_SNAPSHOT:
+		return ERRC_BUSY_SNAPSHOT;
+	case SQLITE_BUSY_RECOVERY:
+		return ERRC_BUSY_RECOVERY;
+	case SQLITE_OK:
+	case SQLITE_ROW:
+	case SQLITE_DONE:
+		return ERRC_NODATA;
+	}
+	switch (rc & 0xff) {
+	case SQLITE_BUSY:
+		return ERRC_BUSY;
+	case SQLITE_LOCKED:
+		return ERRC_LOCKED;
+	case SQLITE_CONSTRAINT:
+		return ERRC_CONSTRAINT;
+	case SQLITE_IOERR:
+		return ERRC_IOERR;
+	}
+	return ERRC_OTHER;
+}
+
+/*
+ * count a failed attempt of tx in phase, from the error left on arg's
+ * connection. only failures inside the measurement window are counted,
+ * as with the retry and failure counters.
+ */
+void tx_error(thread_arg *arg, int tx, int phase)
+{
+	err_shard_t *sh = &shards[arg->number];
+	int rc = sqlite3_extended_errcode(arg->ctx);
+	int ec = err_class(rc);
+	double now;
+
+	if (phase < 0 || phase >= ERR_PHASES)
+		phase = ERR_PHASES - 1;
+	if (get_phase() == PHASE_MEASURE)
+		counter_add(&sh->n[tx][phase][ec], 1);
+
+	now = clock_sec(CLOCK_MONOTONIC);
+	if (now < sh->next_log) {
+		sh->suppressed++;
+		return;
+	}
+	sh->next_log = now + ERR_LOG_INTERVAL;
+	printf("%s %d:%d: error: %s (%s)", tx_name[tx], arg->number, phase,
+	       ec == ERRC_NODATA ? "no data" : sqlite3_errmsg(arg->ctx),
+	       errc_name[ec]);
+	if (sh->suppressed)
+		printf(", %lu more not shown", sh->suppressed);
+	printf("\n");
+	sh->suppressed = 0;
+}
+
+static void sum_classes(uint64_t *sum)
+{
+	int t, tx, ph, ec;
+
+	memset(sum, 0, sizeof(uint64_t) * ERRC_NUMS);
+	for (t = 0; t < num_shards; t++)
+		for (tx = 0; tx < TX_NUMS; tx++)
+			for (ph = 0; ph < ERR_PHASES; ph++)
+				for (ec = 0; ec < ERRC_NUMS; ec++)
+					sum[ec] += counter_read(
+						&shards[t].n[tx][ph][ec]);
+}
+
+/* the errors since the last interval, by class; nothing when none */
+void errstat_interval(void)
+{
+	uint64_t sum[ERRC_NUMS];
+	int ec, first = 1;
+
+	sum_classes(sum);
+	for (ec = 0; ec < ERRC_NUMS; ec++) {
+		if (sum[ec] == prev[ec])
+			continue;
+		printf("%s%s %lu", first ? "      errors: " : ", ",
+		       errc_name[ec], sum[ec] - prev[ec]);
+		first = 0;
+		prev[ec] = sum[ec];
+	}
+	if (!first)
+		printf("\n");
+}
+
+void errstat_report(void)
+{
+	uint64_t n, total = 0;
+	int t, tx, ph, ec;
+
+	printf("\n<Errors> (tx, phase: count by result code; phase 0 is BEGIN/COMMIT)\n");
+	for (tx = 0; tx < TX_NUMS; tx++) {
+		for (ph = 0; ph < ERR_PHASES; ph++) {
+			int first = 1;
+
+			for (ec = 0; ec < ERRC_NUMS; ec++) {
+				for (n = 0, t = 0; t < num_shards; t++)
+					n += counter_read(
+						&shards[t].n[tx][ph][ec]);
+				if (n == 0)
+					continue;
+				if (first)
+					printf("  %-12s %2d:", tx_name[tx], ph);
+				printf(" %s %lu", errc_name[ec], n);
+				first = 0;
+				total += n;
+			}
+			if (!first)
+				printf("\n");
+		}
+	}
+	if (total == 0)
+		printf("  none\n");
+}
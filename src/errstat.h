@@ -0,0 +1,40 @@
+/*
+ * errstat.h
+ * failed statements, counted by tx, phase and sqlite result code
+ *
+ * Every failing attempt of a tx is counted in the shard of the thread
+ * that ran it, under its tx type, the phase it failed in (the tx
+ * function's proceed, 0 for BEGIN/COMMIT) and the class of the
+ * connection's extended result code. The reporter prints the new ones
+ * every interval and all of them at the end. The error message itself
+ * is logged at most once a second per thread.
+ */
+
+#ifndef _TPCC_ERRSTAT_H_
+#define _TPCC_ERRSTAT_H_
+
+#include "main.h"
+
+/* proceed of the tx functions stays below this */
+#define ERR_PHASES 16
+#define ERR_PHASE_CTL 0 /* BEGIN or COMMIT */
+
+enum err_class {
+	ERRC_BUSY,
+	ERRC_BUSY_SNAPSHOT,
+	ERRC_BUSY_RECOVERY,
+	ERRC_LOCKED,
+	ERRC_CONSTRAINT,
+	ERRC_IOERR,
+	ERRC_NODATA, /* no sqlite error: a row missing or malformed */
+	ERRC_OTHER,
+	ERRC_NUMS
+};
+
+int errstat_init(int nthreads);
+void errstat_done(void);
+void tx_error(thread_arg *arg, int tx, int phase);
+void errstat_interval(void);
+void errstat_report(void);
+
+#endif
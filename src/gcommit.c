@@ -0,0 +1,243 @@
+/*
+ * gcommit.c
+ * group commit: one writer thread commits the write txs in batches
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gcommit.h"
+#include "trans_if.h"
+#include "cost.h"
+#include "txphase.h"
+#include "errstat.h"
+
+int group_commit = 0;
+
+static int batch_max = 8;
+static long max_wait_us = 1000;
+
+typedef struct gc_req {
+	thread_arg *arg; /* submitting worker */
+	tx_input_t *in;
+	int ret;
+	int done;
+	struct gc_req *next;
+} gc_req_t;
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work = PTHREAD_COND_INITIALIZER; /* writer waits */
+static pthread_cond_t acked = PTHREAD_COND_INITIALIZER; /* workers wait */
+static gc_req_t *head, **tail = &head;
+static int queued;
+static int stopping;
+
+/* writer side statistics */
+static uint64_t n_batches, n_txs, n_failed, n_full;
+static double commit_sec;
+
+/* -G batch[,max_wait_us] */
+int gcommit_parse(const char *spec)
+{
+	char *end;
+	long b, w = max_wait_us;
+
+	b = strtol(spec, &end, 10);
+	if (end == spec || b < 1)
+		return 1;
+	if (*end == ',') {
+		spec = end + 1;
+		w = strtol(spec, &end, 10);
+		if (end == spec || w < 0)
+			return 1;
+	}
+	if (*end)
+		return 1;
+	group_commit = 1;
+	batch_max = (int)b;
+	max_wait_us = w;
+	return 0;
+}
+
+const char *gcommit_describe(void)
+{
+	static char buf[64];
+
+	snprintf(buf, sizeof(buf), "batch %d, max wait %ld usec.", batch_max,
+		 max_wait_us);
+	return buf;
+}
+
+int gcommit_init(void)
+{
+	head = NULL;
+	tail = &head;
+	queued = 0;
+	stopping = 0;
+	return 0;
+}
+
+/* worker: run in on the writer, wait for the commit of its batch */
+int gcommit_submit(thread_arg *arg, tx_input_t *in)
+{
+	gc_req_t req = { arg, in, 0, 0, NULL };
+
+	pthread_mutex_lock(&mtx);
+	*tail = &req;
+	tail = &req.next;
+	if (++queued == 1 || queued >= batch_max)
+		pthread_cond_signal(&work);
+	while (!req.done)
+		pthread_cond_wait(&acked, &mtx);
+	pthread_mutex_unlock(&mtx);
+	return req.ret;
+}
+
+static void deadline_after(struct timespec *ts, long usec)
+{
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_nsec += (usec % 1000000) * 1000;
+	ts->tv_sec += usec / 1000000 + ts->tv_nsec / 1000000000;
+	ts->tv_nsec %= 1000000000;
+}
+
+/* take the next batch off the queue, NULL once stopped and drained */
+static gc_req_t *next_batch(int *n)
+{
+	struct timespec deadline;
+	gc_req_t *b, **p;
+	int i;
+
+	pthread_mutex_lock(&mtx);
+	while (queued == 0 && !stopping)
+		pthread_cond_wait(&work, &mtx);
+	if (queued > 0 && queued < batch_max && max_wait_us > 0) {
+		/* let the batch fill up a little */
+		deadline_after(&deadline, max_wait_us);
+		while (queued < batch_max && !stopping) {
+			if (pthread_cond_timedwait(&work, &mtx, &deadline))
+				break;
+		}
+	}
+	if (queued >= batch_max)
+		n_full++;
+
+	b = head;
+	for (i = 0, p = &head; *p && i < batch_max; i++)
+		p = &(*p)->next;
+	head = *p;
+	*p = NULL;
+	if (head == NULL)
+		tail = &head;
+	queued -= i;
+	pthread_mutex_unlock(&mtx);
+	*n = i;
+	return b;
+}
+
+/*
+ * run r under a savepoint of the batch tx. returns 1 when it is done,
+ * 0 when it failed and was rolled back alone, and -1 when the batch is
+ * lost: a savepoint statement failed, or an error (IOERR, FULL, ...)
+ * rolled back the batch tx and the savepoint with it.
+ */
+static int run_one(thread_arg *warg, gc_req_t *r)
+{
+	cost_snap_t snap;
+	int ret = -1;
+
+	cost_begin(warg, &snap);
+	txphase_begin(warg, r->in->tx);
+	if (tx_ctl(warg, CTL_SAVEPOINT) != SQLITE_OK)
+		goto ctlerr;
+	if (tx_run(r->arg->number, warg, r->in)) {
+		ret = 1;
+	} else {
+		/* tx_run() counted its error */
+		tx_abort_stmts(warg->ctx);
+		if (sqlite3_get_autocommit(warg->ctx) ||
+		    tx_ctl(warg, CTL_ROLLBACK_TO) != SQLITE_OK)
+			goto out;
+		ret = 0;
+	}
+	if (!sqlite3_get_autocommit(warg->ctx) &&
+	    tx_ctl(warg, CTL_RELEASE) == SQLITE_OK)
+		goto out;
+ctlerr:
+	tx_error(warg, r->in->tx, ERR_PHASE_CTL);
+	ret = -1;
+out:
+	/* the batch COMMIT is not charged to any tx */
+	txphase_end(warg, ret > 0);
+	cost_end(warg, r->in->tx, &snap);
+	return ret;
+}
+
+/* writer thread body, warg holds its connection and statements */
+void gcommit_run(thread_arg *warg)
+{
+	gc_req_t *b, *r, *p;
+	double t0;
+	int n, ok, rc, skipped;
+
+	while ((b = next_batch(&n)) != NULL) {
+		t0 = clock_sec(CLOCK_MONOTONIC);
+		ok = tx_ctl(warg, CTL_IMMEDIATE) == SQLITE_OK;
+		/* once the batch is lost the rest of it is not run */
+		for (r = b; r && ok; r = r->next) {
+			rc = run_one(warg, r);
+			r->ret = rc > 0;
+			ok = rc >= 0;
+		}
+		/* r: the first member not run */
+		if (!ok || tx_ctl(warg, CTL_COMMIT) != SQLITE_OK) {
+			/*
+			 * nothing of the batch made it. the members that
+			 * failed on their own are counted already.
+			 */
+			for (p = b, skipped = 0; p; p = p->next) {
+				skipped |= p == r;
+				if (p->ret || skipped)
+					tx_error(warg, p->in->tx,
+						 ERR_PHASE_CTL);
+				p->ret = 0;
+			}
+			tx_abort_stmts(warg->ctx);
+			if (!sqlite3_get_autocommit(warg->ctx))
+				tx_ctl(warg, CTL_ROLLBACK);
+		}
+		commit_sec += clock_sec(CLOCK_MONOTONIC) - t0;
+		n_batches++;
+		n_txs += n;
+
+		pthread_mutex_lock(&mtx);
+		for (r = b; r; r = r->next) {
+			n_failed += !r->ret;
+			r->done = 1;
+		}
+		pthread_cond_broadcast(&acked);
+		pthread_mutex_unlock(&mtx);
+	}
+}
+
+/* called once no worker submits any more */
+void gcommit_stop(void)
+{
+	pthread_mutex_lock(&mtx);
+	stopping = 1;
+	pthread_cond_signal(&work);
+	pthread_mutex_unlock(&mtx);
+}
+
+void gcommit_report(void)
+{
+	printf("\n<Group Commit>\n");
+	printf("  batches: %lu, txs: %lu (%.2f per batch), failed: %lu\n",
+	       n_batches, n_txs, n_batches ? (double)n_txs / n_batches : 0.0,
+	       n_failed);
+	printf("  full batches: %.1f%%, writer busy: %.3f sec. (%.3f msec. per batch)\n",
+	       n_batches ? 100.0 * n_full / n_batches : 0.0, commit_sec,
+	       n_batches ? 1000.0 * commit_sec / n_batches : 0.0);
+}
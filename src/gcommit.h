@@ -0,0 +1,28 @@
+/*
+ * gcommit.h
+ * group commit: one writer thread commits the write txs in batches
+ *
+ * With -G the workers hand New-Order, Payment and Delivery to a
+ * dedicated writer with its own connection. It runs up to batch of
+ * them back to back inside one transaction, each under a SAVEPOINT of
+ * its own so a failing one rolls back alone, commits once and then
+ * acknowledges every worker of the batch. A batch is closed when it is
+ * full or max_wait usec. after its first tx arrived.
+ */
+
+#ifndef _TPCC_GCOMMIT_H_
+#define _TPCC_GCOMMIT_H_
+
+#include "main.h"
+
+extern int group_commit;
+
+int gcommit_parse(const char *spec);
+const char *gcommit_describe(void);
+int gcommit_init(void);
+int gcommit_submit(thread_arg *arg, tx_input_t *in);
+void gcommit_run(thread_arg *warg);
+void gcommit_stop(void);
+void gcommit_report(void);
+
+#endif
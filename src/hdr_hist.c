@@ -0,0 +1,359 @@
+/*
+ * hdr_hist.c
+ * log-linear (HdrHistogram layout) latency histogram
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <zlib.h>
+
+#include "hdr_hist.h"
+
+/* HdrHistogram V2 encoding, as written by the Java HistogramLogWriter */
+#define V2_ENCODING_COOKIE 0x1c849313
+#define V2_COMPRESSION_COOKIE 0x1c849314
+#define V2_HEADER_SIZE 40
+#define V2_MAX_WORD_SIZE 9
+
+static int buckets_needed(int64_t value, int sub_bucket_count)
+{
+	int64_t smallest_untrackable_value = sub_bucket_count;
+	int buckets = 1;
+
+	while (smallest_untrackable_value <= value) {
+		if (smallest_untrackable_value > INT64_MAX / 2)
+			return buckets + 1;
+		smallest_untrackable_value <<= 1;
+		buckets++;
+	}
+	return buckets;
+}
+
+int hdr_hist_init(hdr_hist_t *h, int64_t highest_trackable_value,
+		  int significant_figures)
+{
+	int64_t largest_single_unit;
+	int sub_bucket_count_magnitude;
+
+	if (significant_figures < 1 || significant_figures > 5 ||
+	    highest_trackable_value < 2)
+		return 1;
+
+	largest_single_unit = 2 * (int64_t)pow(10, significant_figures);
+	sub_bucket_count_magnitude =
+		(int)ceil(log((double)largest_single_unit) / log(2));
+
+	h->highest_trackable_value = highest_trackable_value;
+	h->significant_figures = significant_figures;
+	h->sub_bucket_half_count_magnitude =
+		(sub_bucket_count_magnitude > 1 ? sub_bucket_count_magnitude : 1) -
+		1;
+	h->sub_bucket_count = 1 << (h->sub_bucket_half_count_magnitude + 1);
+	h->sub_bucket_half_count = h->sub_bucket_count / 2;
+	h->sub_bucket_mask = (int64_t)h->sub_bucket_count - 1;
+	h->bucket_count =
+		buckets_needed(highest_trackable_value, h->sub_bucket_count);
+	h->counts_len = (h->bucket_count + 1) * h->sub_bucket_half_count;
+
+	h->counts = calloc(h->counts_len, sizeof(int64_t));
+	if (h->counts == NULL)
+		return 1;
+
+	hdr_hist_reset(h);
+	return 0;
+}
+
+void hdr_hist_done(hdr_hist_t *h)
+{
+	free(h->counts);
+	h->counts = NULL;
+}
+
+void hdr_hist_reset(hdr_hist_t *h)
+{
+	memset(h->counts, 0, h->counts_len * sizeof(int64_t));
+	h->total_count = 0;
+	h->min_value = INT64_MAX;
+	h->max_value = 0;
+}
+
+static int bucket_index_for(const hdr_hist_t *h, int64_t value)
+{
+	int pow2ceiling = 64 - __builtin_clzll(value | h->sub_bucket_mask);
+
+	return pow2ceiling - (h->sub_bucket_half_count_magnitude + 1);
+}
+
+int hdr_hist_index_for(const hdr_hist_t *h, int64_t value)
+{
+	int bucket_index = bucket_index_for(h, value);
+	int sub_bucket_index = (int)(value >> bucket_index);
+
+	return ((bucket_index + 1) << h->sub_bucket_half_count_magnitude) +
+	       (sub_bucket_index - h->sub_bucket_half_count);
+}
+
+int64_t hdr_hist_value_at_index(const hdr_hist_t *h, int index)
+{
+	int bucket_index = (index >> h->sub_bucket_half_count_magnitude) - 1;
+	int sub_bucket_index = (index & (h->sub_bucket_half_count - 1)) +
+			       h->sub_bucket_half_count;
+
+	if (bucket_index < 0) {
+		sub_bucket_index -= h->sub_bucket_half_count;
+		bucket_index = 0;
+	}
+	return (int64_t)sub_bucket_index << bucket_index;
+}
+
+/* largest value that lands in the same bucket as value */
+int64_t hdr_hist_highest_equivalent(const hdr_hist_t *h, int64_t value)
+{
+	int bucket_index = bucket_index_for(h, value);
+	int sub_bucket_index = (int)(value >> bucket_index);
+	int adjusted = sub_bucket_index >= h->sub_bucket_count ?
+			       bucket_index + 1 :
+			       bucket_index;
+	int64_t lowest = (int64_t)sub_bucket_index << bucket_index;
+
+	return lowest + ((int64_t)1 << adjusted) - 1;
+}
+
+/* rebuild total/min/max from counts[] */
+void hdr_hist_recount(hdr_hist_t *h)
+{
+	int i;
+
+	h->total_count = 0;
+	h->min_value = INT64_MAX;
+	h->max_value = 0;
+	for (i = 0; i < h->counts_len; i++) {
+		if (h->counts[i] == 0)
+			continue;
+		h->total_count += h->counts[i];
+		if (h->min_value == INT64_MAX)
+			h->min_value = hdr_hist_value_at_index(h, i);
+		h->max_value = hdr_hist_value_at_index(h, i);
+	}
+}
+
+/* both histograms must share the same layout */
+void hdr_hist_add(hdr_hist_t *dst, const hdr_hist_t *src)
+{
+	int i;
+
+	for (i = 0; i < dst->counts_len; i++)
+		dst->counts[i] += src->counts[i];
+	dst->total_count += src->total_count;
+	if (src->total_count) {
+		if (src->min_value < dst->min_value)
+			dst->min_value = src->min_value;
+		if (src->max_value > dst->max_value)
+			dst->max_value = src->max_value;
+	}
+}
+
+int64_t hdr_hist_value_at_percentile(const hdr_hist_t *h, double percentile)
+{
+	int64_t count_at_percentile, total = 0;
+	int i;
+
+	if (h->total_count == 0)
+		return 0;
+	if (percentile > 100.0)
+		percentile = 100.0;
+	count_at_percentile =
+		(int64_t)(percentile / 100.0 * h->total_count + 0.5);
+	if (count_at_percentile < 1)
+		count_at_percentile = 1;
+
+	for (i = 0; i < h->counts_len; i++) {
+		total += h->counts[i];
+		if (total >= count_at_percentile)
+			return hdr_hist_highest_equivalent(
+				h, hdr_hist_value_at_index(h, i));
+	}
+	return 0;
+}
+
+int64_t hdr_hist_max(const hdr_hist_t *h)
+{
+	if (h->total_count == 0)
+		return 0;
+	return hdr_hist_highest_equivalent(h, h->max_value);
+}
+
+double hdr_hist_mean(const hdr_hist_t *h)
+{
+	double sum = 0.0;
+	int64_t v;
+	int i;
+
+	if (h->total_count == 0)
+		return 0.0;
+	for (i = 0; i < h->counts_len; i++) {
+		if (h->counts[i] == 0)
+			continue;
+		v = hdr_hist_value_at_index(h, i);
+		/* middle of the bucket */
+		sum += (double)h->counts[i] *
+		       ((double)v + hdr_hist_highest_equivalent(h, v)) / 2.0;
+	}
+	return sum / h->total_count;
+}
+
+/*
+ * HdrHistogram log writer
+ */
+
+static void put_be32(unsigned char *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void put_be64(unsigned char *p, uint64_t v)
+{
+	put_be32(p, v >> 32);
+	put_be32(p + 4, (uint32_t)v);
+}
+
+/* ZigZag LEB128, at most 9 bytes (the 9th one carries 8 bits) */
+static int zig_zag_encode(unsigned char *buf, int64_t signed_value)
+{
+	uint64_t value = ((uint64_t)signed_value << 1) ^ (signed_value >> 63);
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		if ((value >> 7) == 0) {
+			buf[i] = (unsigned char)value;
+			return i + 1;
+		}
+		buf[i] = (unsigned char)((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	buf[8] = (unsigned char)value;
+	return 9;
+}
+
+static int encode_v2(const hdr_hist_t *h, unsigned char **out, size_t *len)
+{
+	int counts_limit, i, zeros;
+	unsigned char *buf;
+	size_t n = V2_HEADER_SIZE;
+	int64_t value;
+	double ratio = 1.0;
+	uint64_t ratio_bits;
+
+	counts_limit = h->total_count ? hdr_hist_index_for(h, h->max_value) + 1 :
+					0;
+	buf = malloc(V2_HEADER_SIZE + (size_t)counts_limit * V2_MAX_WORD_SIZE);
+	if (buf == NULL)
+		return 1;
+
+	for (i = 0; i < counts_limit;) {
+		value = h->counts[i++];
+		if (value == 0) {
+			zeros = 1;
+			while (i < counts_limit && h->counts[i] == 0) {
+				zeros++;
+				i++;
+			}
+			value = -zeros;
+		}
+		n += zig_zag_encode(buf + n, value);
+	}
+
+	put_be32(buf, V2_ENCODING_COOKIE);
+	put_be32(buf + 4, n - V2_HEADER_SIZE);
+	put_be32(buf + 8, 0); /* normalizing index offset */
+	put_be32(buf + 12, h->significant_figures);
+	put_be64(buf + 16, 1); /* lowest discernible value */
+	put_be64(buf + 24, h->highest_trackable_value);
+	memcpy(&ratio_bits, &ratio, sizeof(ratio_bits));
+	put_be64(buf + 32, ratio_bits);
+
+	*out = buf;
+	*len = n;
+	return 0;
+}
+
+static const char b64_table[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void base64_write(FILE *f, const unsigned char *p, size_t len)
+{
+	size_t i;
+	uint32_t v;
+
+	for (i = 0; i + 2 < len; i += 3) {
+		v = (p[i] << 16) | (p[i + 1] << 8) | p[i + 2];
+		fputc(b64_table[(v >> 18) & 0x3f], f);
+		fputc(b64_table[(v >> 12) & 0x3f], f);
+		fputc(b64_table[(v >> 6) & 0x3f], f);
+		fputc(b64_table[v & 0x3f], f);
+	}
+	if (i < len) {
+		v = p[i] << 16;
+		if (i + 1 < len)
+			v |= p[i + 1] << 8;
+		fputc(b64_table[(v >> 18) & 0x3f], f);
+		fputc(b64_table[(v >> 12) & 0x3f], f);
+		fputc(i + 1 < len ? b64_table[(v >> 6) & 0x3f] : '=', f);
+		fputc('=', f);
+	}
+}
+
+int hdr_hist_log_header(FILE *f, double start_time)
+{
+	char date[64];
+	time_t t = (time_t)start_time;
+
+	strftime(date, sizeof(date), "%a %b %d %H:%M:%S %Z %Y", localtime(&t));
+	fprintf(f, "#[Histogram log format version 1.3]\n");
+	fprintf(f, "#[StartTime: %.3f (seconds since epoch), %s]\n", start_time,
+		date);
+	fprintf(f, "\"StartTimestamp\",\"Interval_Length\",\"Interval_Max\",\"Interval_Compressed_Histogram\"\n");
+	return ferror(f);
+}
+
+/* one "Tag=...,start,length,max,HISTF..." line */
+int hdr_hist_log_interval(FILE *f, const hdr_hist_t *h, const char *tag,
+			  double start, double length,
+			  double max_value_unit_ratio)
+{
+	unsigned char *raw, *compressed;
+	size_t raw_len;
+	uLongf compressed_len;
+
+	if (encode_v2(h, &raw, &raw_len))
+		return 1;
+
+	compressed_len = compressBound(raw_len);
+	compressed = malloc(8 + compressed_len);
+	if (compressed == NULL ||
+	    compress(compressed + 8, &compressed_len, raw, raw_len) != Z_OK) {
+		free(raw);
+		free(compressed);
+		return 1;
+	}
+	put_be32(compressed, V2_COMPRESSION_COOKIE);
+	put_be32(compressed + 4, compressed_len);
+
+	if (tag)
+		fprintf(f, "Tag=%s,", tag);
+	fprintf(f, "%.3f,%.3f,%.3f,", start, length,
+		hdr_hist_max(h) / max_value_unit_ratio);
+	base64_write(f, compressed, 8 + compressed_len);
+	fputc('\n', f);
+
+	free(raw);
+	free(compressed);
+	return ferror(f);
+}
@@ -0,0 +1,71 @@
+/*
+ * hdr_hist.h
+ * log-linear (HdrHistogram layout) latency histogram
+ */
+
+#ifndef _TPCC_HDR_HIST_H_
+#define _TPCC_HDR_HIST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Values are integers (the driver records microseconds). The bucket
+ * layout is the one used by HdrHistogram with a lowest discernible
+ * value of 1, so encoded histograms can be read by the HdrHistogram
+ * tools unchanged.
+ */
+typedef struct {
+	int64_t highest_trackable_value;
+	int significant_figures;
+	int sub_bucket_half_count_magnitude;
+	int sub_bucket_count;
+	int sub_bucket_half_count;
+	int64_t sub_bucket_mask;
+	int bucket_count;
+	int counts_len;
+	int64_t total_count;
+	int64_t min_value;
+	int64_t max_value;
+	int64_t *counts;
+} hdr_hist_t;
+
+int hdr_hist_init(hdr_hist_t *h, int64_t highest_trackable_value,
+		  int significant_figures);
+void hdr_hist_done(hdr_hist_t *h);
+void hdr_hist_reset(hdr_hist_t *h);
+
+int hdr_hist_index_for(const hdr_hist_t *h, int64_t value);
+int64_t hdr_hist_value_at_index(const hdr_hist_t *h, int index);
+int64_t hdr_hist_highest_equivalent(const hdr_hist_t *h, int64_t value);
+
+/*
+ * Single-writer record path: only bumps counts[] with relaxed atomics,
+ * totals are rebuilt by hdr_hist_recount() on the reader side.
+ */
+static inline void hdr_hist_record(hdr_hist_t *h, int64_t value)
+{
+	int64_t *c;
+
+	if (value < 1)
+		value = 1;
+	else if (value > h->highest_trackable_value)
+		value = h->highest_trackable_value;
+	c = &h->counts[hdr_hist_index_for(h, value)];
+	__atomic_store_n(c, __atomic_load_n(c, __ATOMIC_RELAXED) + 1,
+			 __ATOMIC_RELAXED);
+}
+
+void hdr_hist_recount(hdr_hist_t *h);
+void hdr_hist_add(hdr_hist_t *dst, const hdr_hist_t *src);
+
+int64_t hdr_hist_value_at_percentile(const hdr_hist_t *h, double percentile);
+int64_t hdr_hist_max(const hdr_hist_t *h);
+double hdr_hist_mean(const hdr_hist_t *h);
+
+int hdr_hist_log_header(FILE *f, double start_time);
+int hdr_hist_log_interval(FILE *f, const hdr_hist_t *h, const char *tag,
+			  double start, double length,
+			  double max_value_unit_ratio);
+
+#endif
@@ -0,0 +1,401 @@
+/*
+ * iovfs.c
+ * counting pass-through VFS
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <sqlite3.h>
+
+#include "iovfs.h"
+#include "main.h"
+#include "timers.h"
+
+int iovfs_on = 0;
+
+enum file_type { FT_DB, FT_WAL, FT_SHM, FT_JOURNAL, FT_OTHER, FT_NUMS };
+
+enum io_op {
+	IO_READ,
+	IO_WRITE,
+	IO_SYNC,
+	IO_TRUNCATE,
+	IO_SHMMAP,
+	IO_SHMLOCK,
+	IO_NUMS
+};
+
+static const char *ft_name[FT_NUMS] = { "db", "wal", "shm", "journal",
+					"other" };
+static const char *op_name[IO_NUMS] = { "read",	    "write",  "sync",
+					"truncate", "shmmap", "shmlock" };
+
+/* Instrustats slot an op also adds its time to, -1: none */
+static const int op_slot[IO_NUMS] = { pread_t, pwrite_t, fsync_t, -1, -1,
+				      -1 };
+
+/* shared by every thread: one cache line per (file type, op) */
+typedef struct {
+	uint64_t calls;
+	uint64_t bytes;
+	uint64_t nsec;
+} __attribute__((aligned(CACHE_LINE_SIZE))) io_stat_t;
+
+static io_stat_t stats[FT_NUMS][IO_NUMS];
+
+/* bytes read, written and syncs of the calling thread, for cost.c */
+static __thread uint64_t thread_io[3];
+static io_stat_t prev[FT_NUMS][IO_NUMS]; /* reporter only */
+
+typedef struct {
+	sqlite3_file base;
+	int type;
+	sqlite3_file *real; /* the default VFS's file, right behind us */
+} io_file_t;
+
+static sqlite3_vfs *orig;
+static sqlite3_vfs vfs;
+
+static inline uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void account(int type, int op, uint64_t bytes, uint64_t t0)
+{
+	io_stat_t *st = &stats[type][op];
+	uint64_t ns = now_ns() - t0;
+
+	__atomic_fetch_add(&st->calls, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&st->bytes, bytes, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&st->nsec, ns, __ATOMIC_RELAXED);
+	if (op_slot[op] >= 0)
+		__atomic_fetch_add(&Instrustats[op_slot[op]], ns,
+				   __ATOMIC_RELAXED);
+	if (op == IO_READ)
+		thread_io[0] += bytes;
+	else if (op == IO_WRITE)
+		thread_io[1] += bytes;
+	else if (op == IO_SYNC)
+		thread_io[2]++;
+}
+
+void iovfs_thread_io(uint64_t io[3])
+{
+	memcpy(io, thread_io, sizeof(thread_io));
+}
+
+#define REAL(f) (((io_file_t *)(f))->real)
+#define TYPE(f) (((io_file_t *)(f))->type)
+
+static int io_close(sqlite3_file *f)
+{
+	uint64_t t0 = now_ns();
+	int rc = REAL(f)->pMethods->xClose(REAL(f));
+
+	__atomic_fetch_add(&Instrustats[close_t], now_ns() - t0,
+			   __ATOMIC_RELAXED);
+	return rc;
+}
+
+static int io_read(sqlite3_file *f, void *buf, int n, sqlite3_int64 off)
+{
+	uint64_t t0 = now_ns();
+	int rc = REAL(f)->pMethods->xRead(REAL(f), buf, n, off);
+
+	account(TYPE(f), IO_READ, n, t0);
+	return rc;
+}
+
+static int io_write(sqlite3_file *f, const void *buf, int n,
+		    sqlite3_int64 off)
+{
+	uint64_t t0 = now_ns();
+	int rc = REAL(f)->pMethods->xWrite(REAL(f), buf, n, off);
+
+	account(TYPE(f), IO_WRITE, n, t0);
+	return rc;
+}
+
+static int io_truncate(sqlite3_file *f, sqlite3_int64 size)
+{
+	uint64_t t0 = now_ns();
+	int rc = REAL(f)->pMethods->xTruncate(REAL(f), size);
+
+	account(TYPE(f), IO_TRUNCATE, 0, t0);
+	return rc;
+}
+
+static int io_sync(sqlite3_file *f, int flags)
+{
+	uint64_t t0 = now_ns();
+	int rc = REAL(f)->pMethods->xSync(REAL(f), flags);
+
+	account(TYPE(f), IO_SYNC, 0, t0);
+	return rc;
+}
+
+static int io_file_size(sqlite3_file *f, sqlite3_int64 *size)
+{
+	return REAL(f)->pMethods->xFileSize(REAL(f), size);
+}
+
+static int io_lock(sqlite3_file *f, int lock)
+{
+	return REAL(f)->pMethods->xLock(REAL(f), lock);
+}
+
+static int io_unlock(sqlite3_file *f, int lock)
+{
+	return REAL(f)->pMethods->xUnlock(REAL(f), lock);
+}
+
+static int io_check_reserved(sqlite3_file *f, int *out)
+{
+	return REAL(f)->pMethods->xCheckReservedLock(REAL(f), out);
+}
+
+static int io_file_control(sqlite3_file *f, int op, void *arg)
+{
+	return REAL(f)->pMethods->xFileControl(REAL(f), op, arg);
+}
+
+static int io_sector_size(sqlite3_file *f)
+{
+	return REAL(f)->pMethods->xSectorSize(REAL(f));
+}
+
+static int io_device_chars(sqlite3_file *f)
+{
+	return REAL(f)->pMethods->xDeviceCharacteristics(REAL(f));
+}
+
+/* the shm calls come in on the main db file, counted as FT_SHM */
+static int io_shm_map(sqlite3_file *f, int pg, int pgsz, int extend,
+		      void volatile **pp)
+{
+	uint64_t t0 = now_ns();
+	int rc = REAL(f)->pMethods->xShmMap(REAL(f), pg, pgsz, extend, pp);
+
+	account(FT_SHM, IO_SHMMAP, pgsz, t0);
+	return rc;
+}
+
+static int io_shm_lock(sqlite3_file *f, int offset, int n, int flags)
+{
+	uint64_t t0 = now_ns();
+	int rc = REAL(f)->pMethods->xShmLock(REAL(f), offset, n, flags);
+
+	account(FT_SHM, IO_SHMLOCK, 0, t0);
+	return rc;
+}
+
+static void io_shm_barrier(sqlite3_file *f)
+{
+	REAL(f)->pMethods->xShmBarrier(REAL(f));
+}
+
+static int io_shm_unmap(sqlite3_file *f, int del)
+{
+	return REAL(f)->pMethods->xShmUnmap(REAL(f), del);
+}
+
+static int io_fetch(sqlite3_file *f, sqlite3_int64 off, int n, void **pp)
+{
+	return REAL(f)->pMethods->xFetch(REAL(f), off, n, pp);
+}
+
+static int io_unfetch(sqlite3_file *f, sqlite3_int64 off, void *p)
+{
+	return REAL(f)->pMethods->xUnfetch(REAL(f), off, p);
+}
+
+static const sqlite3_io_methods io_methods = {
+	3,		   io_close,	      io_read,
+	io_write,	   io_truncate,	      io_sync,
+	io_file_size,	   io_lock,	      io_unlock,
+	io_check_reserved, io_file_control,   io_sector_size,
+	io_device_chars,   io_shm_map,	      io_shm_lock,
+	io_shm_barrier,	   io_shm_unmap,      io_fetch,
+	io_unfetch,
+};
+
+static int file_type(int flags)
+{
+	if (flags & SQLITE_OPEN_MAIN_DB)
+		return FT_DB;
+	if (flags & SQLITE_OPEN_WAL)
+		return FT_WAL;
+	if (flags & SQLITE_OPEN_MAIN_JOURNAL)
+		return FT_JOURNAL;
+	return FT_OTHER;
+}
+
+static int vfs_open(sqlite3_vfs *v, const char *name, sqlite3_file *f,
+		    int flags, int *out_flags)
+{
+	io_file_t *p = (io_file_t *)f;
+	uint64_t t0 = now_ns();
+	int rc;
+
+	p->type = file_type(flags);
+	p->real = (sqlite3_file *)(p + 1);
+	rc = orig->xOpen(orig, name, p->real, flags, out_flags);
+	/* only a file the default VFS opened gets our methods */
+	p->base.pMethods = p->real->pMethods ? &io_methods : NULL;
+	__atomic_fetch_add(&Instrustats[open_t], now_ns() - t0,
+			   __ATOMIC_RELAXED);
+	return rc;
+}
+
+static int vfs_delete(sqlite3_vfs *v, const char *name, int sync_dir)
+{
+	uint64_t t0 = now_ns();
+	int rc = orig->xDelete(orig, name, sync_dir);
+
+	__atomic_fetch_add(&Instrustats[unlink_t], now_ns() - t0,
+			   __ATOMIC_RELAXED);
+	return rc;
+}
+
+static int vfs_access(sqlite3_vfs *v, const char *name, int flags, int *out)
+{
+	return orig->xAccess(orig, name, flags, out);
+}
+
+static int vfs_full_pathname(sqlite3_vfs *v, const char *name, int n,
+			     char *out)
+{
+	return orig->xFullPathname(orig, name, n, out);
+}
+
+static void *vfs_dlopen(sqlite3_vfs *v, const char *name)
+{
+	return orig->xDlOpen(orig, name);
+}
+
+static void vfs_dlerror(sqlite3_vfs *v, int n, char *msg)
+{
+	orig->xDlError(orig, n, msg);
+}
+
+static void (*vfs_dlsym(sqlite3_vfs *v, void *h, const char *sym))(void)
+{
+	return orig->xDlSym(orig, h, sym);
+}
+
+static void vfs_dlclose(sqlite3_vfs *v, void *h)
+{
+	orig->xDlClose(orig, h);
+}
+
+static int vfs_randomness(sqlite3_vfs *v, int n, char *out)
+{
+	return orig->xRandomness(orig, n, out);
+}
+
+static int vfs_sleep(sqlite3_vfs *v, int us)
+{
+	return orig->xSleep(orig, us);
+}
+
+static int vfs_current_time(sqlite3_vfs *v, double *t)
+{
+	return orig->xCurrentTime(orig, t);
+}
+
+static int vfs_last_error(sqlite3_vfs *v, int n, char *msg)
+{
+	return orig->xGetLastError(orig, n, msg);
+}
+
+static int vfs_current_time64(sqlite3_vfs *v, sqlite3_int64 *t)
+{
+	return orig->xCurrentTimeInt64(orig, t);
+}
+
+/* make the counting VFS the default, before any connection is opened */
+int iovfs_register(void)
+{
+	orig = sqlite3_vfs_find(NULL);
+	if (orig == NULL || orig->iVersion < 2)
+		return 1;
+	memset(&vfs, 0, sizeof(vfs));
+	vfs.iVersion = 2;
+	vfs.szOsFile = sizeof(io_file_t) + orig->szOsFile;
+	vfs.mxPathname = orig->mxPathname;
+	vfs.zName = "tpcc-count";
+	vfs.xOpen = vfs_open;
+	vfs.xDelete = vfs_delete;
+	vfs.xAccess = vfs_access;
+	vfs.xFullPathname = vfs_full_pathname;
+	vfs.xDlOpen = vfs_dlopen;
+	vfs.xDlError = vfs_dlerror;
+	vfs.xDlSym = vfs_dlsym;
+	vfs.xDlClose = vfs_dlclose;
+	vfs.xRandomness = vfs_randomness;
+	vfs.xSleep = vfs_sleep;
+	vfs.xCurrentTime = vfs_current_time;
+	vfs.xGetLastError = vfs_last_error;
+	vfs.xCurrentTimeInt64 = vfs_current_time64;
+	return sqlite3_vfs_register(&vfs, 1) != SQLITE_OK;
+}
+
+static void read_stat(io_stat_t *dst, io_stat_t *src)
+{
+	dst->calls = __atomic_load_n(&src->calls, __ATOMIC_RELAXED);
+	dst->bytes = __atomic_load_n(&src->bytes, __ATOMIC_RELAXED);
+	dst->nsec = __atomic_load_n(&src->nsec, __ATOMIC_RELAXED);
+}
+
+/* one line per file type with I/O since the last interval */
+void iovfs_interval(void)
+{
+	io_stat_t cur;
+	int t, op, first;
+
+	for (t = 0; t < FT_NUMS; t++) {
+		first = 1;
+		for (op = 0; op < IO_NUMS; op++) {
+			read_stat(&cur, &stats[t][op]);
+			if (cur.calls == prev[t][op].calls)
+				continue;
+			if (first)
+				printf("      io %-7s", ft_name[t]);
+			printf(" %s %lu/%.1fKB/%.3fms", op_name[op],
+			       cur.calls - prev[t][op].calls,
+			       (cur.bytes - prev[t][op].bytes) / 1024.0,
+			       (cur.nsec - prev[t][op].nsec) / 1e6);
+			first = 0;
+			prev[t][op] = cur;
+		}
+		if (!first)
+			printf("\n");
+	}
+}
+
+void iovfs_report(void)
+{
+	io_stat_t cur;
+	int t, op;
+
+	printf("\n<I/O> (whole run)\n");
+	printf("  file    op            calls         MB    time(s)  avg(us)\n");
+	for (t = 0; t < FT_NUMS; t++) {
+		for (op = 0; op < IO_NUMS; op++) {
+			read_stat(&cur, &stats[t][op]);
+			if (cur.calls == 0)
+				continue;
+			printf("  %-7s %-8s %10lu %10.1f %10.3f %8.1f\n",
+			       ft_name[t], op_name[op], cur.calls,
+			       cur.bytes / 1048576.0, cur.nsec / 1e9,
+			       cur.nsec / 1e3 / cur.calls);
+		}
+	}
+}
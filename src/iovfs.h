@@ -0,0 +1,24 @@
+/*
+ * iovfs.h
+ * counting pass-through VFS
+ *
+ * With -V a VFS that forwards every call to the default one is
+ * registered as the default before any connection is opened. It counts
+ * calls, bytes and nanoseconds of reads, writes, syncs, truncates and
+ * the shared memory calls, per file type (main db, WAL, shm, journal,
+ * other), and adds its times to the I/O slots of Instrustats.
+ */
+
+#ifndef _TPCC_IOVFS_H_
+#define _TPCC_IOVFS_H_
+
+#include <stdint.h>
+
+extern int iovfs_on;
+
+int iovfs_register(void);
+void iovfs_thread_io(uint64_t io[3]);
+void iovfs_interval(void);
+void iovfs_report(void);
+
+#endif
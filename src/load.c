@@ -20,17 +20,30 @@
 
 #include "spt_proc.h"
 #include "tpc.h"
+#include "shard.h"
+#include "profile.h"
 
 #define NNULL ((void *)0)
 //#undef NULL
 
 sqlite3 *sqlite;
-sqlite3_stmt *stmt[11];
+sqlite3_stmt **stmt; /* NUM_LOAD_STMTS per shard */
+
+#define NUM_LOAD_STMTS 11
+/* insert statement i, against the shard owning warehouse w */
+#define LSTMT(i, w) stmt[shard_of(w) * NUM_LOAD_STMTS + (i)]
 
 /* Global SQL Variables */
 char timestamp[81];
 long count_ware;
-int fd, seed;
+int fd;
+
+/* the loader is single-threaded, one generator stream is enough */
+static rnd_ctx_t rnd;
+static uint64_t seed;
+static int seed_flg = 0;
+static const char *profile_spec = NULL;
+static const char *profile_file = NULL;
 
 int particle_flg = 0; /* "1" means particle mode */
 int part_no = 0; /* 1:items 2:warehouse 3:customer 4:orders */
@@ -96,7 +109,7 @@ int main(int argc, char *argv[])
 
 	/* Parse args */
 
-	while ((c = getopt(argc, argv, "w:l:m:n:f:")) != -1) {
+	while ((c = getopt(argc, argv, "w:l:m:n:f:s:S:p:F:")) != -1) {
 		switch (c) {
 		case 'w':
 			printf("option w with value '%s'\n", optarg);
@@ -119,8 +132,25 @@ int main(int argc, char *argv[])
 			printf("option w with value '%s'\n", optarg);
 			dbpath = strdup(optarg);
 			break;
+		case 's':
+			printf("option s with value '%s'\n", optarg);
+			seed = strtoull(optarg, NULL, 0);
+			seed_flg = 1;
+			break;
+		case 'S':
+			printf("option S with value '%s'\n", optarg);
+			num_db_shards = atoi(optarg);
+			break;
+		case 'p':
+			printf("option p with value '%s'\n", optarg);
+			profile_spec = optarg;
+			break;
+		case 'F':
+			printf("option F with value '%s'\n", optarg);
+			profile_file = optarg;
+			break;
 		case '?':
-			printf("Usage: tpcc_load -w warehouses -m min_wh -n max_wh -f db_file\n");
+			printf("Usage: tpcc_load -w warehouses -m min_wh -n max_wh -f db_file [-s seed] [-S shards] [-p profile[,pragma=value,...]] [-F profile_file]\n");
 			printf("* [part]: 1=ITEMS 2=WAREHOUSE 3=CUSTOMER 4=ORDERS\n");
 			exit(0);
 		default:
@@ -143,13 +173,37 @@ int main(int argc, char *argv[])
 		max_ware = count_ware;
 	}
 
+	if (num_db_shards < 0 || num_db_shards > count_ware) {
+		printf("shards (-S) must be between 0 and warehouses (-w)\n");
+		exit(-1);
+	}
+	/* same warehouse to shard mapping as tpcc_start */
+	shard_init(num_db_shards, count_ware);
+	if (num_db_shards > 0)
+		printf("     [shards]: %d\n", num_db_shards);
+
+	/* without -p, "default" (after -F), as in tpcc_start */
+	if (profile_file && profile_load(profile_file))
+		exit(-1);
+	if (profile_spec && profile_select(profile_spec)) {
+		printf("unknown profile (-p) %s\n", profile_spec);
+		exit(-1);
+	}
+	printf("    [profile]: %s\n", profile_describe());
+
 	if (particle_flg == 1) {
 		printf("  [part(1-4)]: %d\n", part_no);
 		printf("     [MIN WH]: %d\n", min_ware);
 		printf("     [MAX WH]: %d\n", max_ware);
 	}
 
-	init_randomness();
+	if (!seed_flg)
+		seed = init_randomness();
+	printf("       [seed]: %llu\n", (unsigned long long)seed);
+	SetSeed(&rnd, seed, 0);
+	NURand_init(&rnd, 0);
+	printf("   [NURand C]: C_LAST %u, C_ID %u, OL_I_ID %u\n",
+	       NURand_C(255, 0), NURand_C(1023, 0), NURand_C(8191, 0));
 
 	/* Initialize timestamp (for date columns) */
 	gettimestamp(timestamp, STRFTIME_FORMAT, TIMESTAMP_LEN);
@@ -167,11 +221,28 @@ int main(int argc, char *argv[])
 	    if(!stmt[i]) goto Error_SqlCall_close;
     }
     */
-	for (int i = 0; i < 11; ++i) {
-		if (sqlite3_prepare_v2(sqlite, sql_statements[i], -1, &stmt[i], NULL) != SQLITE_OK)
+	if (num_db_shards > 0) {
+		if (shard_create(sqlite, dbpath) ||
+		    shard_attach(sqlite, dbpath))
 			goto Error_SqlCall_close;
 	}
 
+	if (profile_apply(sqlite, 0))
+		goto Error_SqlCall_close;
+
+	stmt = calloc(shard_sets() * NUM_LOAD_STMTS, sizeof(sqlite3_stmt *));
+	for (int k = 0; k < shard_sets(); ++k) {
+		for (int i = 0; i < NUM_LOAD_STMTS; ++i) {
+			char *sql = shard_sql(sql_statements[i], k);
+			int rc = sqlite3_prepare_v2(sqlite, sql, -1,
+						    &stmt[k * NUM_LOAD_STMTS + i],
+						    NULL);
+			sqlite3_free(sql);
+			if (rc != SQLITE_OK)
+				goto Error_SqlCall_close;
+		}
+	}
+
 	/* exec sql begin transaction; */
 
 	printf("TPCC Data Load Started...\n");
@@ -206,7 +277,7 @@ int main(int argc, char *argv[])
 
 	//if( sqlite3_exec(sqlite, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) goto Error_SqlCall;
 
-	for (i = 0; i < 11; i++) {
+	for (i = 0; i < shard_sets() * NUM_LOAD_STMTS; i++) {
 		sqlite3_reset(stmt[i]);
 	}
 
@@ -252,7 +323,7 @@ void LoadItems()
 		orig[i] = 0;
 	for (i = 0; i < MAXITEMS / 10; i++) {
 		do {
-			pos = RandomNumber(0L, MAXITEMS);
+			pos = RandomNumber(&rnd, 0L, MAXITEMS);
 		} while (orig[pos]);
 		orig[pos] = 1;
 	}
@@ -267,17 +338,17 @@ retry:
 
 	for (i_id = 1; i_id <= MAXITEMS; i_id++) {
 		/* Generate Item Data */
-		i_im_id = RandomNumber(1L, 10000L);
+		i_im_id = RandomNumber(&rnd, 1L, 10000L);
 
-		i_name[MakeAlphaString(14, 24, i_name)] = 0;
+		i_name[MakeAlphaString(&rnd, 14, 24, i_name)] = 0;
 
-		i_price = ((int)RandomNumber(100L, 10000L)) / 100.0;
+		i_price = ((int)RandomNumber(&rnd, 100L, 10000L)) / 100.0;
 
-		idatasiz = MakeAlphaString(26, 50, i_data);
+		idatasiz = MakeAlphaString(&rnd, 26, 50, i_data);
 		i_data[idatasiz] = 0;
 
 		if (orig[i_id]) {
-			pos = RandomNumber(0L, idatasiz - 8);
+			pos = RandomNumber(&rnd, 0L, idatasiz - 8);
 			i_data[pos] = 'o';
 			i_data[pos + 1] = 'r';
 			i_data[pos + 2] = 'i';
@@ -375,11 +446,11 @@ retry:
 			goto sqlerr;
 		/* Generate Warehouse Data */
 
-		w_name[MakeAlphaString(6, 10, w_name)] = 0;
+		w_name[MakeAlphaString(&rnd, 6, 10, w_name)] = 0;
 
 		MakeAddress(w_street_1, w_street_2, w_city, w_state, w_zip);
 
-		w_tax = ((float)RandomNumber(10L, 20L)) / 100.0;
+		w_tax = ((float)RandomNumber(&rnd, 10L, 20L)) / 100.0;
 		w_ytd = 300000.00;
 
 		if (option_debug)
@@ -392,7 +463,7 @@ retry:
 				       :w_street_1,:w_street_2,:w_city,:w_state,
 				       :w_zip,:w_tax,:w_ytd);*/
 
-		sqlite_stmt = stmt[1];
+		sqlite_stmt = LSTMT(1, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, w_id);
 		sqlite3_bind_text(sqlite_stmt, 2, w_name, -1, SQLITE_STATIC);
@@ -529,7 +600,7 @@ int w_id;
 		orig[i] = 0;
 	for (i = 0; i < MAXITEMS / 10; i++) {
 		do {
-			pos = RandomNumber(0L, MAXITEMS);
+			pos = RandomNumber(&rnd, 0L, MAXITEMS);
 		} while (orig[pos]);
 		orig[pos] = 1;
 	}
@@ -537,23 +608,23 @@ int w_id;
 retry:
 	for (s_i_id = 1; s_i_id <= MAXITEMS; s_i_id++) {
 		/* Generate Stock Data */
-		s_quantity = RandomNumber(10L, 100L);
-
-		s_dist_01[MakeAlphaString(24, 24, s_dist_01)] = 0;
-		s_dist_02[MakeAlphaString(24, 24, s_dist_02)] = 0;
-		s_dist_03[MakeAlphaString(24, 24, s_dist_03)] = 0;
-		s_dist_04[MakeAlphaString(24, 24, s_dist_04)] = 0;
-		s_dist_05[MakeAlphaString(24, 24, s_dist_05)] = 0;
-		s_dist_06[MakeAlphaString(24, 24, s_dist_06)] = 0;
-		s_dist_07[MakeAlphaString(24, 24, s_dist_07)] = 0;
-		s_dist_08[MakeAlphaString(24, 24, s_dist_08)] = 0;
-		s_dist_09[MakeAlphaString(24, 24, s_dist_09)] = 0;
-		s_dist_10[MakeAlphaString(24, 24, s_dist_10)] = 0;
-		sdatasiz = MakeAlphaString(26, 50, s_data);
+		s_quantity = RandomNumber(&rnd, 10L, 100L);
+
+		s_dist_01[MakeAlphaString(&rnd, 24, 24, s_dist_01)] = 0;
+		s_dist_02[MakeAlphaString(&rnd, 24, 24, s_dist_02)] = 0;
+		s_dist_03[MakeAlphaString(&rnd, 24, 24, s_dist_03)] = 0;
+		s_dist_04[MakeAlphaString(&rnd, 24, 24, s_dist_04)] = 0;
+		s_dist_05[MakeAlphaString(&rnd, 24, 24, s_dist_05)] = 0;
+		s_dist_06[MakeAlphaString(&rnd, 24, 24, s_dist_06)] = 0;
+		s_dist_07[MakeAlphaString(&rnd, 24, 24, s_dist_07)] = 0;
+		s_dist_08[MakeAlphaString(&rnd, 24, 24, s_dist_08)] = 0;
+		s_dist_09[MakeAlphaString(&rnd, 24, 24, s_dist_09)] = 0;
+		s_dist_10[MakeAlphaString(&rnd, 24, 24, s_dist_10)] = 0;
+		sdatasiz = MakeAlphaString(&rnd, 26, 50, s_data);
 		s_data[sdatasiz] = 0;
 
 		if (orig[s_i_id]) {
-			pos = RandomNumber(0L, sdatasiz - 8);
+			pos = RandomNumber(&rnd, 0L, sdatasiz - 8);
 
 			s_data[pos] = 'o';
 			s_data[pos + 1] = 'r';
@@ -571,7 +642,7 @@ retry:
 				       :s_dist_06,:s_dist_07,:s_dist_08,:s_dist_09,:s_dist_10,
 				       0, 0, 0,:s_data);*/
 
-		sqlite_stmt = stmt[2];
+		sqlite_stmt = LSTMT(2, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, s_i_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, s_w_id);
@@ -651,10 +722,10 @@ retry:
 	for (d_id = 1; d_id <= DIST_PER_WARE; d_id++) {
 		/* Generate District Data */
 
-		d_name[MakeAlphaString(6L, 10L, d_name)] = 0;
+		d_name[MakeAlphaString(&rnd, 6L, 10L, d_name)] = 0;
 		MakeAddress(d_street_1, d_street_2, d_city, d_state, d_zip);
 
-		d_tax = ((float)RandomNumber(10L, 20L)) / 100.0;
+		d_tax = ((float)RandomNumber(&rnd, 10L, 20L)) / 100.0;
 
 		/*EXEC SQL INSERT INTO
 		                district
@@ -662,7 +733,7 @@ retry:
 				       :d_street_1,:d_street_2,:d_city,:d_state,:d_zip,
 				       :d_tax,:d_ytd,:d_next_o_id);*/
 
-		sqlite_stmt = stmt[3];
+		sqlite_stmt = LSTMT(3, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, d_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, d_w_id);
@@ -748,7 +819,7 @@ retry:
 		c_d_id = d_id;
 		c_w_id = w_id;
 
-		c_first[MakeAlphaString(8, 16, c_first)] = 0;
+		c_first[MakeAlphaString(&rnd, 8, 16, c_first)] = 0;
 		c_middle[0] = 'O';
 		c_middle[1] = 'E';
 		c_middle[2] = 0;
@@ -756,13 +827,13 @@ retry:
 		if (c_id <= 1000) {
 			Lastname(c_id - 1, c_last);
 		} else {
-			Lastname(NURand(255, 0, 999), c_last);
+			Lastname(NURand(&rnd, 255, 0, 999), c_last);
 		}
 
 		MakeAddress(c_street_1, c_street_2, c_city, c_state, c_zip);
-		c_phone[MakeNumberString(16, 16, c_phone)] = 0;
+		c_phone[MakeNumberString(&rnd, 16, 16, c_phone)] = 0;
 
-		if (RandomNumber(0L, 1L))
+		if (RandomNumber(&rnd, 0L, 1L))
 			c_credit[0] = 'G';
 		else
 			c_credit[0] = 'B';
@@ -770,10 +841,10 @@ retry:
 		c_credit[2] = 0;
 
 		c_credit_lim = 50000;
-		c_discount = ((float)RandomNumber(0L, 50L)) / 100.0;
+		c_discount = ((float)RandomNumber(&rnd, 0L, 50L)) / 100.0;
 		c_balance = -10.0;
 
-		c_data[MakeAlphaString(300, 500, c_data)] = 0;
+		c_data[MakeAlphaString(&rnd, 300, 500, c_data)] = 0;
 
 		/*EXEC SQL INSERT INTO
 		                customer
@@ -786,7 +857,7 @@ retry:
 				  :c_credit_lim,:c_discount,:c_balance,
 				  10.0, 1, 0,:c_data);*/
 
-		sqlite_stmt = stmt[4];
+		sqlite_stmt = LSTMT(4, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, c_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
@@ -817,7 +888,7 @@ retry:
 
 		h_amount = 10.0;
 
-		h_data[MakeAlphaString(12, 24, h_data)] = 0;
+		h_data[MakeAlphaString(&rnd, 12, 24, h_data)] = 0;
 
 		/*EXEC SQL INSERT INTO
 		                history
@@ -825,7 +896,7 @@ retry:
 				       :c_d_id,:c_w_id, :timestamp,
 				       :h_amount,:h_data);*/
 
-		sqlite_stmt = stmt[5];
+		sqlite_stmt = LSTMT(5, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, c_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
@@ -897,15 +968,15 @@ retry:
 	if (retried)
 		printf("Retrying ...\n");
 	retried = 1;
-	InitPermutation(); /* initialize permutation of customer numbers */
+	InitPermutation(&rnd); /* initialize permutation of customer numbers */
 
 	//if( sqlite3_exec(sqlite, "BEGIN TRANSACTION;", NULL, NULL, NULL) != SQLITE_OK) goto sqlerr;
 
 	for (o_id = 1; o_id <= ORD_PER_DIST; o_id++) {
 		/* Generate Order Data */
 		o_c_id = GetPermutation();
-		o_carrier_id = RandomNumber(1L, 10L);
-		o_ol_cnt = RandomNumber(5L, 15L);
+		o_carrier_id = RandomNumber(&rnd, 1L, 10L);
+		o_ol_cnt = RandomNumber(&rnd, 5L, 15L);
 
 		if (o_id > 2100) { /* the last 900 orders have not been
 					 * delivered) */
@@ -915,7 +986,7 @@ retry:
 					       :timestamp,
 					       NULL,:o_ol_cnt, 1);*/
 
-			sqlite_stmt = stmt[6];
+			sqlite_stmt = LSTMT(6, w_id);
 
 			sqlite3_bind_int64(sqlite_stmt, 1, o_id);
 			sqlite3_bind_int64(sqlite_stmt, 2, o_d_id);
@@ -934,7 +1005,7 @@ retry:
 			                new_orders
 			                values(:o_id,:o_d_id,:o_w_id);*/
 
-			sqlite_stmt = stmt[7];
+			sqlite_stmt = LSTMT(7, w_id);
 
 			sqlite3_bind_int64(sqlite_stmt, 1, o_id);
 			sqlite3_bind_int64(sqlite_stmt, 2, o_d_id);
@@ -952,7 +1023,7 @@ retry:
 				   :timestamp,
 				   :o_carrier_id,:o_ol_cnt, 1);*/
 
-			sqlite_stmt = stmt[8];
+			sqlite_stmt = LSTMT(8, w_id);
 
 			sqlite3_bind_int64(sqlite_stmt, 1, o_id);
 			sqlite3_bind_int64(sqlite_stmt, 2, o_d_id);
@@ -975,14 +1046,14 @@ retry:
 
 		for (ol = 1; ol <= o_ol_cnt; ol++) {
 			/* Generate Order Line Data */
-			ol_i_id = RandomNumber(1L, MAXITEMS);
+			ol_i_id = RandomNumber(&rnd, 1L, MAXITEMS);
 			ol_supply_w_id = o_w_id;
 			ol_quantity = 5;
 			ol_amount = 0.0;
 
-			ol_dist_info[MakeAlphaString(24, 24, ol_dist_info)] = 0;
+			ol_dist_info[MakeAlphaString(&rnd, 24, 24, ol_dist_info)] = 0;
 
-			tmp_float = (float)(RandomNumber(10L, 10000L)) / 100.0;
+			tmp_float = (float)(RandomNumber(&rnd, 10L, 10000L)) / 100.0;
 
 			if (o_id > 2100) {
 				/*EXEC SQL INSERT INTO
@@ -990,7 +1061,7 @@ retry:
 				                values(:o_id,:o_d_id,:o_w_id,:ol,
 						       :ol_i_id,:ol_supply_w_id, NULL,
 						       :ol_quantity,:tmp_float,:ol_dist_info);*/
-				sqlite_stmt = stmt[9];
+				sqlite_stmt = LSTMT(9, w_id);
 
 				sqlite3_bind_int64(sqlite_stmt, 1, o_id);
 				sqlite3_bind_int64(sqlite_stmt, 2, o_d_id);
@@ -1017,7 +1088,7 @@ retry:
 					   :timestamp,
 					   :ol_quantity,:ol_amount,:ol_dist_info);*/
 
-				sqlite_stmt = stmt[10];
+				sqlite_stmt = LSTMT(10, w_id);
 
 				sqlite3_bind_int64(sqlite_stmt, 1, o_id);
 				sqlite3_bind_int64(sqlite_stmt, 2, o_d_id);
@@ -1071,11 +1142,11 @@ char *city;
 char *state;
 char *zip;
 {
-	str1[MakeAlphaString(10, 20, str1)] = 0; /* Street 1 */
-	str2[MakeAlphaString(10, 20, str2)] = 0; /* Street 2 */
-	city[MakeAlphaString(10, 20, city)] = 0; /* City */
-	state[MakeAlphaString(2, 2, state)] = 0; /* State */
-	zip[MakeNumberString(9, 9, zip)] = 0; /* Zip */
+	str1[MakeAlphaString(&rnd, 10, 20, str1)] = 0; /* Street 1 */
+	str2[MakeAlphaString(&rnd, 10, 20, str2)] = 0; /* Street 2 */
+	city[MakeAlphaString(&rnd, 10, 20, city)] = 0; /* City */
+	state[MakeAlphaString(&rnd, 2, 2, state)] = 0; /* State */
+	zip[MakeNumberString(&rnd, 9, 9, zip)] = 0; /* Zip */
 }
 
 /*
@@ -0,0 +1,207 @@
+/*
+ * lockwait.c
+ * waiting for the database write lock
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lockwait.h"
+
+int writer_admission = 0;
+
+/* busy handler: sleep base << n usec. (capped), give up after timeout */
+static int busy_on = 1;
+static long busy_base_us = 100;
+static long busy_max_us = 10000;
+static long busy_timeout_ms = 5000;
+
+/* FIFO ticket lock, waiters sleep on the condition variable */
+typedef struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	unsigned long next; /* next ticket to hand out */
+	unsigned long serving;
+} __attribute__((aligned(CACHE_LINE_SIZE))) wlock_t;
+
+/* times tx_step() steps a statement again before giving up */
+#define STEP_RETRY 8
+
+static wlock_t *locks;
+static int num_locks;
+
+/* -B off | base_us[,max_us[,timeout_ms]] */
+int busy_parse(const char *spec)
+{
+	long v[3] = { busy_base_us, busy_max_us, busy_timeout_ms };
+	char *end;
+	int i;
+
+	if (strcmp(spec, "off") == 0) {
+		busy_on = 0;
+		return 0;
+	}
+	for (i = 0; i < 3 && *spec; i++) {
+		v[i] = strtol(spec, &end, 10);
+		if (end == spec || v[i] <= 0 || (*end && *end != ','))
+			return 1;
+		spec = *end ? end + 1 : end;
+	}
+	if (*spec || v[1] < v[0])
+		return 1;
+	busy_on = 1;
+	busy_base_us = v[0];
+	busy_max_us = v[1];
+	busy_timeout_ms = v[2];
+	return 0;
+}
+
+const char *busy_describe(void)
+{
+	static char buf[96];
+
+	if (!busy_on)
+		return "off";
+	snprintf(buf, sizeof(buf), "backoff %ld..%ld usec., timeout %ld msec.",
+		 busy_base_us, busy_max_us, busy_timeout_ms);
+	return buf;
+}
+
+/* "equal jitter": half of the backoff fixed, half random */
+static void backoff_sleep(thread_arg *arg, int n)
+{
+	long cap;
+	double us;
+	struct timespec ts;
+
+	cap = n < 30 ? busy_base_us << n : busy_max_us;
+	if (cap > busy_max_us)
+		cap = busy_max_us;
+	us = cap / 2 +
+	     (rnd_next(&arg->backoff_rnd) >> 11) * (1.0 / 9007199254740992.0) *
+		     (cap - cap / 2);
+	ts.tv_sec = (time_t)(us / 1000000);
+	ts.tv_nsec = (long)((us - ts.tv_sec * 1000000.0) * 1000.0);
+	nanosleep(&ts, NULL);
+}
+
+static int busy_handler(void *p, int n)
+{
+	thread_arg *arg = p;
+	double t0;
+
+	t0 = clock_sec(CLOCK_MONOTONIC);
+	if (n == 0)
+		arg->busy_since = t0;
+	else if ((t0 - arg->busy_since) * 1000.0 >= busy_timeout_ms)
+		return 0; /* give up, SQLITE_BUSY to the caller */
+
+	backoff_sleep(arg, n);
+	arg->time.lock_wait += clock_sec(CLOCK_MONOTONIC) - t0;
+	return 1;
+}
+
+void busy_install(thread_arg *arg)
+{
+	if (busy_on)
+		sqlite3_busy_handler(arg->ctx, busy_handler, arg);
+}
+
+/*
+ * sqlite3_step() for the statements of a tx. a statement that gets
+ * SQLITE_BUSY on its first step has not changed anything (sqlite undoes
+ * a failed statement on its own), so it is reset and stepped again
+ * after a backoff, keeping the work the tx has already done. a stale
+ * WAL snapshot (SQLITE_BUSY_SNAPSHOT) cannot be waited out and goes
+ * back to the caller, which restarts the whole tx. with the busy
+ * handler on, SQLITE_BUSY means its timeout is spent: no retry then,
+ * or one statement could wait STEP_RETRY timeouts.
+ */
+int tx_step(thread_arg *arg, sqlite3_stmt *st)
+{
+	int first = !sqlite3_stmt_busy(st);
+	int rc, n = 0;
+	double t0;
+
+	rc = sqlite3_step(st);
+	while (rc == SQLITE_BUSY && !busy_on && first && n < STEP_RETRY &&
+	       sqlite3_extended_errcode(arg->ctx) != SQLITE_BUSY_SNAPSHOT) {
+		t0 = clock_sec(CLOCK_MONOTONIC);
+		sqlite3_reset(st);
+		backoff_sleep(arg, n++);
+		arg->time.lock_wait += clock_sec(CLOCK_MONOTONIC) - t0;
+		arg->step_retries++;
+		rc = sqlite3_step(st);
+	}
+	return rc;
+}
+
+int admission_init(int nlocks)
+{
+	int i;
+
+	num_locks = nlocks;
+	if (posix_memalign((void **)&locks, CACHE_LINE_SIZE,
+			   sizeof(wlock_t) * nlocks))
+		return 1;
+	for (i = 0; i < nlocks; i++) {
+		pthread_mutex_init(&locks[i].mtx, NULL);
+		pthread_cond_init(&locks[i].cond, NULL);
+		locks[i].next = locks[i].serving = 0;
+	}
+	return 0;
+}
+
+void admission_done(void)
+{
+	int i;
+
+	for (i = 0; i < num_locks; i++) {
+		pthread_mutex_destroy(&locks[i].mtx);
+		pthread_cond_destroy(&locks[i].cond);
+	}
+	free(locks);
+	locks = NULL;
+}
+
+/*
+ * wait for our turn to write shards ks[0..n), in arrival order. ks is
+ * ascending (tx_write_shards()), so two writers never wait for each
+ * other's shards.
+ */
+void admission_enter(thread_arg *arg, const int *ks, int n)
+{
+	wlock_t *l;
+	unsigned long ticket;
+	double t0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		l = &locks[ks[i]];
+		pthread_mutex_lock(&l->mtx);
+		ticket = l->next++;
+		if (l->serving != ticket) {
+			t0 = clock_sec(CLOCK_MONOTONIC);
+			while (l->serving != ticket)
+				pthread_cond_wait(&l->cond, &l->mtx);
+			arg->time.lock_wait += clock_sec(CLOCK_MONOTONIC) - t0;
+		}
+		pthread_mutex_unlock(&l->mtx);
+	}
+}
+
+void admission_leave(const int *ks, int n)
+{
+	wlock_t *l;
+	int i;
+
+	for (i = n - 1; i >= 0; i--) {
+		l = &locks[ks[i]];
+		pthread_mutex_lock(&l->mtx);
+		l->serving++;
+		pthread_cond_broadcast(&l->cond);
+		pthread_mutex_unlock(&l->mtx);
+	}
+}
@@ -0,0 +1,31 @@
+/*
+ * lockwait.h
+ * waiting for the database write lock
+ *
+ * Writers can queue in-process for the write locks of the files they
+ * write (-L, FIFO ticket lock, one per shard, taken in shard order),
+ * and every connection gets a busy handler that sleeps with exponential
+ * backoff and jitter instead of handing SQLITE_BUSY straight back (-B).
+ * With -B off, a statement that gets SQLITE_BUSY is retried on its own
+ * by tx_step() instead, without restarting its tx. All of them add the
+ * time they wait to thread_time_t.lock_wait.
+ */
+
+#ifndef _TPCC_LOCKWAIT_H_
+#define _TPCC_LOCKWAIT_H_
+
+#include "main.h"
+
+extern int writer_admission;
+
+int busy_parse(const char *spec);
+const char *busy_describe(void);
+void busy_install(thread_arg *arg);
+int tx_step(thread_arg *arg, sqlite3_stmt *st);
+
+int admission_init(int nlocks);
+void admission_done(void);
+void admission_enter(thread_arg *arg, const int *ks, int n);
+void admission_leave(const int *ks, int n);
+
+#endif
@@ -12,6 +12,8 @@
 #include <pthread.h>
 #include <fcntl.h>
 #include <time.h>
+#include <errno.h>
+#include <math.h>
 
 #include <sqlite3.h>
 
@@ -22,11 +24,26 @@
 #include "rthist.h"
 #include "sb_percentile.h"
 #include "main.h"
+#include "counters.h"
+#include "terminal.h"
+#include "remote.h"
+#include "lockwait.h"
+#include "gcommit.h"
+#include "rpool.h"
+#include "errstat.h"
+#include "profile.h"
+#include "ckpt.h"
+#include "iovfs.h"
+#include "cost.h"
+#include "stmtprof.h"
+#include "txphase.h"
+#include "slowlog.h"
 
 int num_ware;
 int num_conn;
 int lampup_time;
 int measure_time;
+int rampdown_time;
 
 int num_node; /* number of servers that consists of cluster i.e. RAC (0:normal mode)*/
 #define NUM_NODE_MAX 8
@@ -36,16 +53,9 @@ int multi_schema = 0;
 int multi_schema_offset = 0;
 
 all_tx_stat_t g_stats;
-all_tx_stat_t* stats_per_thread;
 
-int prev_s[5];
-int prev_l[5];
-
-double max_rt[5];
-double total_rt[5];
-double cur_max_rt[5];
-
-double prev_total_rt[5];
+uint64_t prev_s[5];
+uint64_t prev_l[5];
 
 #define RTIME_NEWORD 5
 #define RTIME_PAYMENT 5
@@ -66,12 +76,9 @@ const char *tx_name[TX_NUMS] = {
 
 sb_percentile_t local_percentile;
 
-int activate_transaction;
-double time_taken;
-clock_t time_start;
-clock_t time_end;
-int counting_on;
-int num_trans;
+int run_phase;
+pthread_barrier_t start_barrier;
+int num_trans; /* per-thread cap, 0: run until stopped */
 
 long clk_tck;
 
@@ -79,6 +86,22 @@ int is_local = 0; /* "1" mean local */
 int valuable_flg = 0; /* "1" mean valuable ratio */
 
 char *dbpath = NULL;
+char *hist_log_path = NULL;
+static const char *profile_spec = NULL;
+static const char *profile_file = NULL;
+static int phase_report = 0; /* -E */
+
+uint64_t seed;
+int seed_flg = 0;
+static int affinity_flg = 0; /* -a given */
+
+/* open-loop mode: global (-R) or per-terminal (-Q) arrivals/sec. */
+double global_rate = 0.0;
+double terminal_rate = 0.0;
+int arrival_dist = ARRIVAL_POISSON;
+
+/* terminal emulation: 10 terminals per warehouse with keying/think time */
+int terminal_mode = 0;
 
 
 /* stat helper functions */
@@ -93,7 +116,7 @@ void clear_all_tx_stats(all_tx_stat_t *st)
 		clear_tx_stat(&st->stat[tx]);
 }
 
-void check_individual_constraint(enum tx_type tx, float lowerbound, int total)
+void check_individual_constraint(enum tx_type tx, float lowerbound, uint64_t total)
 {
 	float f = 100.0 * (float)(g_stats.stat[tx].success + g_stats.stat[tx].late) /(float)total;
 	printf("        %s: %3.2f%% (>=%.1f%%)", tx_name[tx], f, lowerbound);
@@ -111,7 +134,7 @@ void check_individual_response_time(enum tx_type tx, float lowerbound)
 void check_constraints_and_response_times()
 {
 	printf("\n<Constraint Check> (all must be [OK])\n [transaction percentage]\n");
-	int j = 0;
+	uint64_t j = 0;
 	for (int i = 0; i < 5; i++)
 		j += g_stats.stat[i].success + g_stats.stat[i].late;
 
@@ -127,6 +150,14 @@ void check_constraints_and_response_times()
 
 
 int thread_main(thread_arg *);
+static void report_affinity_groups(thread_arg *thd_arg);
+static void *writer_main(void *p);
+static int ro_pool_open(void);
+static int explain_statements(void);
+static void ro_pool_close(void);
+
+/* group commit: the one connection that runs the writers' transactions */
+static thread_arg writer_arg __attribute__((aligned(CACHE_LINE_SIZE)));
 
 void alarm_handler(int signum);
 void alarm_dummy();
@@ -136,9 +167,12 @@ int main(int argc, char *argv[])
 	int i, k, t_num, arg_offset, c;
 	long j;
 	float f;
+	double measure_start = 0.0, measure_end = 0.0, time_taken;
+	struct timespec deadline;
 	thread_arg *thd_arg;
 	struct itimerval itval;
 	struct sigaction sigact;
+	rnd_ctx_t nurand_rnd;
 
 	printf("CHECKING IF SQLITE IS THREADSAFE: RETURN VALUE = %d\n",
 	       sqlite3_threadsafe());
@@ -148,9 +182,7 @@ int main(int argc, char *argv[])
 	printf("***************************************\n");
 
 	/* initialize */
-	hist_init();
-	activate_transaction = 1;
-	counting_on = 0;
+	run_phase = PHASE_RAMPUP;
 
 	for (i = 0; i < 5; i++) {
 		g_stats.stat[i].success = 0;
@@ -160,10 +192,6 @@ int main(int argc, char *argv[])
 
 		prev_s[i] = 0;
 		prev_l[i] = 0;
-
-		prev_total_rt[i] = 0.0;
-		max_rt[i] = 0.0;
-		total_rt[i] = 0.0;
 	}
 
 	/* dummy initialize*/
@@ -171,7 +199,8 @@ int main(int argc, char *argv[])
 	num_conn = 10;
 	lampup_time = 5;
 	measure_time = 20;
-	num_trans = 10000;
+	rampdown_time = 0;
+	num_trans = 0;
 
 	/* number of node (default 0) */
 	num_node = 0;
@@ -181,7 +210,7 @@ int main(int argc, char *argv[])
 
 	/* Parse args */
 
-	while ((c = getopt(argc, argv, "w:c:r:l:i:m:o:t:0:1:2:3:4:f:")) != -1) {
+	while ((c = getopt(argc, argv, "w:c:r:l:d:i:m:o:t:0:1:2:3:4:f:H:s:R:Q:A:Kk:a:S:Nb:LB:G:P:p:F:C:VTEO:")) != -1) {
 		switch (c) {
 		case 'w':
 			printf("option w with value '%s'\n", optarg);
@@ -199,6 +228,10 @@ int main(int argc, char *argv[])
 			printf("option l with value '%s'\n", optarg);
 			measure_time = atoi(optarg);
 			break;
+		case 'd':
+			printf("option d with value '%s'\n", optarg);
+			rampdown_time = atoi(optarg);
+			break;
 		case 'm':
 			printf("option m (multiple schemas) with value '%s'\n",
 			       optarg);
@@ -247,8 +280,140 @@ int main(int argc, char *argv[])
 			printf("option f with value '%s'\n", optarg);
 			dbpath = strdup(optarg);
 			break;
+		case 'H':
+			printf("option H (HdrHistogram log) with value '%s'\n",
+			       optarg);
+			hist_log_path = strdup(optarg);
+			break;
+		case 's':
+			printf("option s (random seed) with value '%s'\n", optarg);
+			seed = strtoull(optarg, NULL, 0);
+			seed_flg = 1;
+			break;
+		case 'R':
+			printf("option R (global arrival rate) with value '%s'\n",
+			       optarg);
+			global_rate = atof(optarg);
+			break;
+		case 'Q':
+			printf("option Q (per-terminal arrival rate) with value '%s'\n",
+			       optarg);
+			terminal_rate = atof(optarg);
+			break;
+		case 'A':
+			printf("option A (arrival distribution) with value '%s'\n",
+			       optarg);
+			if (strcmp(optarg, "poisson") == 0) {
+				arrival_dist = ARRIVAL_POISSON;
+			} else if (strcmp(optarg, "constant") == 0) {
+				arrival_dist = ARRIVAL_CONSTANT;
+			} else {
+				fprintf(stderr, "unknown arrival distribution %s\n",
+					optarg);
+				exit(1);
+			}
+			break;
+		case 'K':
+			printf("option K (terminal emulation)\n");
+			terminal_mode = 1;
+			break;
+		case 'k':
+			printf("option k (keying/think time scale) with value '%s'\n",
+			       optarg);
+			term_time_scale = atof(optarg);
+			break;
+		case 'a':
+			printf("option a (warehouse affinity) with value '%s'\n",
+			       optarg);
+			if (affinity_parse(optarg)) {
+				fprintf(stderr, "unknown affinity policy %s (uniform, home, partition:N, numa)\n",
+					optarg);
+				exit(1);
+			}
+			affinity_flg = 1;
+			break;
+		case 'S':
+			printf("option S (database shards) with value '%s'\n",
+			       optarg);
+			num_db_shards = atoi(optarg);
+			break;
+		case 'N':
+			printf("option N (shared-nothing)\n");
+			shared_nothing = 1;
+			break;
+		case 'L':
+			printf("option L (writer admission queue)\n");
+			writer_admission = 1;
+			break;
+		case 'B':
+			printf("option B (busy handler) with value '%s'\n", optarg);
+			if (busy_parse(optarg)) {
+				fprintf(stderr, "bad busy handler spec %s (off | base_us[,max_us[,timeout_ms]])\n",
+					optarg);
+				exit(1);
+			}
+			break;
+		case 'G':
+			printf("option G (group commit) with value '%s'\n", optarg);
+			if (gcommit_parse(optarg)) {
+				fprintf(stderr, "bad group commit spec %s (batch[,max_wait_us])\n",
+					optarg);
+				exit(1);
+			}
+			break;
+		case 'P':
+			printf("option P (read-only pool) with value '%s'\n", optarg);
+			ro_pool_size = atoi(optarg);
+			break;
+		case 'p':
+			printf("option p (profile) with value '%s'\n", optarg);
+			profile_spec = optarg;
+			break;
+		case 'F':
+			printf("option F (profile file) with value '%s'\n", optarg);
+			profile_file = optarg;
+			break;
+		case 'C':
+			printf("option C (checkpointer) with value '%s'\n", optarg);
+			if (ckpt_parse(optarg)) {
+				fprintf(stderr, "bad checkpointer spec %s (passive|full|restart|truncate[,frames=N][,interval=msec])\n",
+					optarg);
+				exit(1);
+			}
+			break;
+		case 'V':
+			printf("option V (I/O accounting)\n");
+			iovfs_on = 1;
+			break;
+		case 'T':
+			printf("option T (statement profile)\n");
+			stmtprof_on = 1;
+			break;
+		case 'E':
+			printf("option E (phase breakdown)\n");
+			txphase_on = 1;
+			phase_report = 1;
+			break;
+		case 'O':
+			printf("option O (slow tx log) with value '%s'\n", optarg);
+			if (slowlog_parse(optarg)) {
+				fprintf(stderr, "bad slow tx log spec %s (count[,file])\n",
+					optarg);
+				exit(1);
+			}
+			/* the entries carry the phase times */
+			txphase_on = 1;
+			break;
+		case 'b':
+			printf("option b (begin mode) with value '%s'\n", optarg);
+			if (begin_mode_parse(optarg)) {
+				fprintf(stderr, "bad begin mode %s ([tx=]deferred|immediate|exclusive,...)\n",
+					optarg);
+				exit(1);
+			}
+			break;
 		case '?':
-			printf("Usage: tpcc_start -w warehouses -c connections -r warmup_time -l running_time -i report_interval -f db_file\n");
+			printf("Usage: tpcc_start -w warehouses -c connections -r warmup_time -l running_time [-d rampdown_time] -i report_interval -f db_file [-H hdr_log_file] [-s seed] [-R total_rate | -Q terminal_rate] [-A poisson|constant] [-K [-k time_scale]] [-a uniform|home|partition:N|numa] [-S shards] [-N] [-b [tx=]deferred|immediate|exclusive,...] [-L] [-B off|base_us[,max_us[,timeout_ms]]] [-G batch[,max_wait_us]] [-P readonly_connections] [-p profile[,pragma=value,...]] [-F profile_file] [-C mode[,frames=N][,interval=msec]] [-V] [-T] [-E] [-O count[,file]]\n");
 			exit(0);
 		default:
 			printf("?? getopt returned character code 0%o ??\n", c);
@@ -277,6 +442,68 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	/* one shard and one warehouse range per thread */
+	if (shared_nothing) {
+		char spec[32];
+
+		if (affinity_flg) {
+			fprintf(stderr, "-a cannot be combined with -N\n");
+			exit(1);
+		}
+
+		if (num_conn > num_ware ||
+		    (num_db_shards && num_db_shards != num_conn)) {
+			fprintf(stderr,
+				"\n shared-nothing needs [shards] == [connection] <= [warehouse].\n");
+			exit(1);
+		}
+		num_db_shards = num_conn;
+		snprintf(spec, sizeof(spec), "partition:%d", num_conn);
+		affinity_parse(spec);
+	}
+
+	if (iovfs_on && iovfs_register()) {
+		fprintf(stderr, "error at iovfs_register()\n");
+		exit(1);
+	}
+
+	if (profile_file && profile_load(profile_file))
+		exit(1);
+	if (profile_spec && profile_select(profile_spec)) {
+		fprintf(stderr, "bad profile %s (name[,pragma=value,...])\n",
+			profile_spec);
+		exit(1);
+	}
+
+	if (ckpt_on && shared_nothing) {
+		fprintf(stderr, "-C cannot be combined with -N\n");
+		exit(1);
+	}
+
+	if (group_commit && shared_nothing) {
+		fprintf(stderr, "-G cannot be combined with -N\n");
+		exit(1);
+	}
+
+	if (ro_pool_size < 0 || (ro_pool_size > 0 && shared_nothing)) {
+		fprintf(stderr, "-P needs a positive size and cannot be combined with -N\n");
+		exit(1);
+	}
+
+	if (num_db_shards < 0 || num_db_shards > num_ware) {
+		fprintf(stderr, "\n [shards] must be between 0 and [warehouse].\n");
+		exit(1);
+	}
+	shard_init(num_db_shards, num_ware);
+
+	/* tx_begin() has no per-shard EXCLUSIVE */
+	for (i = 0; i < TX_NUMS; i++) {
+		if (num_db_shards > 0 && begin_mode[i] == CTL_EXCLUSIVE) {
+			fprintf(stderr, "-b exclusive cannot be combined with -S or -N\n");
+			exit(1);
+		}
+	}
+
 	if (num_node > 0) {
 		if (num_ware % num_node != 0) {
 			fprintf(stderr,
@@ -288,6 +515,13 @@ int main(int argc, char *argv[])
 				"\n [connection] value must be devided by [num_node].\n");
 			exit(1);
 		}
+		/* the old per-node split is the partition policy */
+		if (affinity_policy == AFF_UNIFORM) {
+			char spec[32];
+
+			snprintf(spec, sizeof(spec), "partition:%d", num_node);
+			affinity_parse(spec);
+		}
 	}
 
 	printf("<Parameters>\n");
@@ -295,6 +529,63 @@ int main(int argc, char *argv[])
 	printf(" [connection]: %d\n", num_conn);
 	printf("     [rampup]: %d (sec.)\n", lampup_time);
 	printf("    [measure]: %d (sec.)\n", measure_time);
+	printf("   [rampdown]: %d (sec.)\n", rampdown_time);
+	if (num_trans)
+		printf("  [max trans]: %d (per thread)\n", num_trans);
+	if (global_rate > 0 && terminal_rate > 0) {
+		fprintf(stderr, "-R and -Q are mutually exclusive\n");
+		exit(1);
+	}
+	if (terminal_mode) {
+		if (global_rate > 0 || terminal_rate > 0) {
+			fprintf(stderr, "-K cannot be combined with -R/-Q\n");
+			exit(1);
+		}
+		/* no point in more connections than terminals */
+		if (num_conn > num_ware * TERMINALS_PER_WARE) {
+			num_conn = num_ware * TERMINALS_PER_WARE;
+			printf(" [connection]: %d (one per terminal)\n", num_conn);
+		}
+		printf("  [terminals]: %d (%d per warehouse), time scale %.3f\n",
+		       num_ware * TERMINALS_PER_WARE, TERMINALS_PER_WARE,
+		       term_time_scale);
+	}
+	if (global_rate > 0)
+		terminal_rate = global_rate / num_conn;
+	if (num_db_shards > 0)
+		printf("     [shards]: %d (%s.s0 .. %s.s%d)%s\n", num_db_shards,
+		       dbpath, dbpath, num_db_shards - 1,
+		       shared_nothing ? ", shared-nothing" : "");
+	printf("    [profile]: %s\n", profile_describe());
+	printf("      [begin]:");
+	for (i = 0; i < TX_NUMS; i++)
+		printf(" %s %s%s", tx_name[i], begin_mode_name(begin_mode[i]),
+		       i < TX_NUMS - 1 ? "," : "");
+	printf("%s\n", num_db_shards > 0 ?
+				" (immediate: deferred, then the write locks of the tx's shards)" :
+				"");
+	printf("       [busy]: %s%s\n", busy_describe(),
+	       writer_admission ? ", writers queue in-process" : "");
+	if (ckpt_on)
+		printf(" [checkpoint]: %s, in the background\n",
+		       ckpt_describe());
+	if (slowlog_on)
+		printf("   [slow txs]: %s\n", slowlog_describe());
+	if (ro_pool_size > 0)
+		printf("    [ro pool]: %d connections for %s and %s\n",
+		       ro_pool_size, tx_name[TX_ORDSTAT], tx_name[TX_SLEV]);
+	if (group_commit)
+		printf("[group commit]: %s\n", gcommit_describe());
+	printf("   [affinity]: %s (%d groups)\n", affinity_name(),
+	       affinity_num_groups(num_conn, num_ware));
+	if (terminal_rate > 0)
+		printf("       [rate]: %.3f tx/s per terminal, %s arrivals\n",
+		       terminal_rate,
+		       arrival_dist == ARRIVAL_POISSON ? "poisson" : "constant");
+
+	if (!seed_flg)
+		seed = init_randomness();
+	printf("       [seed]: %llu\n", (unsigned long long)seed);
 
 	if (valuable_flg == 1) {
 		printf("      [ratio]: %d:%d:%d:%d:%d\n",
@@ -320,7 +611,13 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
-	init_randomness();
+	/* NURand C constants come from stream 0, threads use 1..num_conn */
+	SetSeed(&nurand_rnd, seed, 0);
+	NURand_init(&nurand_rnd, 1);
+	/* C_LAST of the load matches tpcc_load run with the same -s */
+	printf("   [NURand C]: C_LAST %u (load %u), C_ID %u, OL_I_ID %u\n",
+	       NURand_C(255, 0), NURand_C(255, 1), NURand_C(1023, 0),
+	       NURand_C(8191, 0));
 
 	if (valuable_flg == 0) {
 		seq_init(10, 10, 1, 1, 1); /* normal ratio */
@@ -332,11 +629,60 @@ int main(int argc, char *argv[])
 			 atoi(argv[13 + arg_offset]));
 	}
 
-	if (sb_percentile_init(&local_percentile, 100000, 1.0, 1e13))
+	if (sb_percentile_init(&local_percentile, 100000, 1.0, 1e13,
+			       num_conn))
 		return -1;
 
+	if (counters_init(num_conn)) {
+		fprintf(stderr, "error at counters_init()\n");
+		exit(1);
+	}
+
+	/* one more for the group commit writer */
+	if (errstat_init(num_conn + 1)) {
+		fprintf(stderr, "error at errstat_init()\n");
+		exit(1);
+	}
+
+	if (cost_init(num_conn + 1)) {
+		fprintf(stderr, "error at cost_init()\n");
+		exit(1);
+	}
+
+	if (phase_report && txphase_init(num_conn + 1)) {
+		fprintf(stderr, "error at txphase_init()\n");
+		exit(1);
+	}
+
+	if (slowlog_on && slowlog_init(num_conn)) {
+		fprintf(stderr, "error at slowlog_init()\n");
+		exit(1);
+	}
+
+	if (hist_init(num_conn)) {
+		fprintf(stderr, "error at hist_init()\n");
+		exit(1);
+	}
+
+	if (writer_admission && admission_init(shard_sets())) {
+		fprintf(stderr, "error at admission_init()\n");
+		exit(1);
+	}
+
+	if (group_commit && gcommit_init()) {
+		fprintf(stderr, "error at gcommit_init()\n");
+		exit(1);
+	}
+
+	if (shared_nothing && remote_init(num_conn)) {
+		fprintf(stderr, "error at remote_init()\n");
+		exit(1);
+	}
+
 	/* set up threads */
-	thd_arg = malloc(sizeof(thread_arg) * num_conn);
+	if (posix_memalign((void **)&thd_arg, CACHE_LINE_SIZE,
+			   sizeof(thread_arg) * num_conn))
+		thd_arg = NULL;
 	if (thd_arg == NULL) {
 		fprintf(stderr, "error at malloc(thread_arg)\n");
 		exit(1);
@@ -344,14 +690,63 @@ int main(int argc, char *argv[])
 
 	/* EXEC SQL WHENEVER SQLERROR GOTO sqlerr; */
 
-	counting_on = 0;
+	/* workers and main meet here once every connection is ready */
+	if (pthread_barrier_init(&start_barrier, NULL, num_conn + 1)) {
+		fprintf(stderr, "error at pthread_barrier_init()\n");
+		exit(1);
+	}
 
 	for (t_num = 0; t_num < num_conn; t_num++) {
 		thread_arg *arg = &thd_arg[t_num];
 		arg->number = t_num;
-		clear_all_tx_stats(&arg->stats);
+		arg->counters = counters_get(t_num);
+		SetSeed(&arg->rnd, seed, t_num + 1);
+		SetSeed(&arg->backoff_rnd, seed, num_conn + t_num + 1);
+		arg->deck = seq_deck_new(&arg->rnd);
+		if (arg->deck == NULL) {
+			fprintf(stderr, "error at seq_deck_new()\n");
+			exit(1);
+		}
 		arg->ctx = NULL;
-		arg->stmt = malloc(sizeof(sqlite3_stmt *) * 40);
+		arg->stmt = calloc(shard_sets() * NUM_SQL_STATEMENTS,
+				   sizeof(sqlite3_stmt *));
+		memset(&arg->time, 0, sizeof(arg->time));
+		arg->step_retries = 0;
+		arg->rate = terminal_rate;
+		affinity_assign(&arg->aff, t_num, num_conn, num_ware);
+		arg->remote = shared_nothing ? remote_get(t_num) : NULL;
+		arg->scheduled = terminal_rate > 0 || terminal_mode;
+	}
+
+	if (num_db_shards > 0 && shard_check(dbpath)) {
+		fprintf(stderr, "error at shard_check()\n");
+		exit(1);
+	}
+
+	if (stmtprof_on && explain_statements()) {
+		fprintf(stderr, "error at explain_statements()\n");
+		exit(1);
+	}
+
+	if (ro_pool_size > 0 && ro_pool_open()) {
+		fprintf(stderr, "error at ro_pool_open()\n");
+		exit(1);
+	}
+
+	if (ckpt_on && ckpt_start(dbpath)) {
+		fprintf(stderr, "error at ckpt_start()\n");
+		exit(1);
+	}
+
+	if (group_commit) {
+		thread_arg *arg = &writer_arg;
+		arg->number = num_conn;
+		SetSeed(&arg->rnd, seed, 2 * num_conn + 1);
+		SetSeed(&arg->backoff_rnd, seed, 2 * num_conn + 2);
+		arg->stmt = calloc(shard_sets() * NUM_SQL_STATEMENTS,
+				   sizeof(sqlite3_stmt *));
+		arg->remote = NULL;
+		pthread_create(&arg->pth, NULL, writer_main, arg);
 	}
 
 	for (t_num = 0; t_num < num_conn; t_num++) {
@@ -359,75 +754,95 @@ int main(int argc, char *argv[])
 		pthread_create(&arg->pth, NULL, (void *)thread_main, (void *)arg);
 	}
 
+	pthread_barrier_wait(&start_barrier);
+
 	printf("\nRAMP-UP TIME.(%d sec.)\n", lampup_time);
 	fflush(stdout);
-	sleep(lampup_time);
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += lampup_time;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+			       NULL) == EINTR)
+		;
 	printf("\nMEASURING START.\n\n");
 	fflush(stdout);
 
-	/* sleep(measure_time); */
-	/* start timer */
-
-// #ifndef _SLEEP_ONLY_
-// 	if (setitimer(ITIMER_REAL, &itval, NULL) == -1) {
-// 		fprintf(stderr, "error in setitimer()\n");
-// 	}
-// #endif
-
-	counting_on = 1;
-	/* wait signal */
-	/*
-  for(i = 0; i < (measure_time / PRINT_INTERVAL); i++ ) {
-  //while (activate_transaction) {
-#ifndef _SLEEP_ONLY_
-    pause();
-#else
-    sleep(PRINT_INTERVAL);
-    alarm_dummy();
-#endif
-  }
-  */
-	for (int i = 0; i < (measure_time / PRINT_INTERVAL); ++i) {
-		sleep(PRINT_INTERVAL);
+	sb_percentile_reset(&local_percentile);
+	hist_reset();
+	if (hist_log_path && hist_log_open(hist_log_path))
+		fprintf(stderr, "error opening HdrHistogram log %s\n",
+			hist_log_path);
+
+	measure_start = clock_sec(CLOCK_MONOTONIC);
+	__atomic_store_n(&run_phase, PHASE_MEASURE, __ATOMIC_RELEASE);
+
+	/* report on absolute deadlines so the window does not drift */
+	for (i = 0; i < (measure_time / PRINT_INTERVAL); ++i) {
+		deadline.tv_sec += PRINT_INTERVAL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &deadline, NULL) == EINTR)
+			;
+		if (i == (measure_time / PRINT_INTERVAL) - 1) {
+			__atomic_store_n(&run_phase, PHASE_RAMPDOWN,
+					 __ATOMIC_RELEASE);
+			measure_end = clock_sec(CLOCK_MONOTONIC);
+		}
 		alarm_dummy();
 	}
-	// sleep(measure_time);
-	counting_on = 0;
+	if (measure_time / PRINT_INTERVAL == 0) {
+		__atomic_store_n(&run_phase, PHASE_RAMPDOWN, __ATOMIC_RELEASE);
+		measure_end = clock_sec(CLOCK_MONOTONIC);
+	}
 
-// #ifndef _SLEEP_ONLY_
-// 	/* stop timer */
-// 	itval.it_interval.tv_sec = 0;
-// 	itval.it_interval.tv_usec = 0;
-// 	itval.it_value.tv_sec = 0;
-// 	itval.it_value.tv_usec = 0;
-// 	if (setitimer(ITIMER_REAL, &itval, NULL) == -1) {
-// 		fprintf(stderr, "error in setitimer()\n");
-// 	}
-// #endif
+	if (rampdown_time > 0) {
+		printf("\nRAMP-DOWN TIME.(%d sec.)\n", rampdown_time);
+		fflush(stdout);
+		deadline.tv_sec += rampdown_time;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &deadline, NULL) == EINTR)
+			;
+	}
 
 	printf("\nSTOPPING THREADS");
-	activate_transaction = 0;
+	__atomic_store_n(&run_phase, PHASE_STOP, __ATOMIC_RELEASE);
 
 	/* wait threads' ending and close connections*/
 	for (i = 0; i < num_conn; i++) {
 		pthread_join(thd_arg[i].pth, NULL);
 		free(thd_arg[i].stmt);
+		seq_deck_free(thd_arg[i].deck);
+	}
+	if (group_commit) {
+		gcommit_stop();
+		pthread_join(writer_arg.pth, NULL);
+		free(writer_arg.stmt);
 	}
+	if (ro_pool_size > 0)
+		ro_pool_close();
+	if (ckpt_on)
+		ckpt_stop();
+	pthread_barrier_destroy(&start_barrier);
 
 	printf("\n");
 
-	free(thd_arg);
+	counters_collect(&g_stats);
+	hist_log_close();
 
-	//hist_report();
 	printf("\n<Raw Results>\n");
 	for (enum tx_type tx = 0; tx < TX_NUMS; ++tx) {
 		tx_stat_t *st = &g_stats.stat[tx];
-		printf("  [%d:%s] sc:%d lt:%d  rt:%d  fl:%d avg_rt: %.1f (%d)\n",
+		printf("  [%d:%s] sc:%lu lt:%lu  rt:%lu  fl:%lu avg_rt: %.1f (%d)\n",
 		       tx, tx_name[tx], st->success, st->late, st->retry, st->failure,
-		       total_rt[tx] / (st->success + st->late), rt_limit[tx]);
+		       hist_total_mean(tx), rt_limit[tx]);
 	}
-	printf(" in %d sec.\n",
-	       (measure_time / PRINT_INTERVAL) * PRINT_INTERVAL);
+	time_taken = measure_end - measure_start;
+	printf(" in %.3f sec.\n", time_taken);
+	printf("  95%%: %.3f, 99%%: %.3f\n",
+	       sb_percentile_calculate_total(&local_percentile, 95),
+	       sb_percentile_calculate_total(&local_percentile, 99));
+	sb_percentile_done(&local_percentile);
+	hist_report();
+	if (phase_report)
+		txphase_report();
 
 	printf("\n<Raw Results2(sum from per-thread stats)>\n");
 
@@ -439,27 +854,77 @@ int main(int argc, char *argv[])
 		st->retry = 0;
 		st->failure = 0;
 		for (k = 0; k < num_conn; k++) {
-			tx_stat_t *per_thread = &thd_arg[k].stats.stat[tx];
+			tx_stat_t *per_thread = &thd_arg[k].counters->stats.stat[tx];
 			st->success += per_thread->success;
 			st->late += per_thread->late;
 			st->retry += per_thread->retry;
 			st->failure += per_thread->failure;
 		}
-		printf("  [%d:%s] sc:%d lt:%d  rt:%d  fl:%d avg_rt: %.1f (%d)\n",
+		printf("  [%d:%s] sc:%lu lt:%lu  rt:%lu  fl:%lu avg_rt: %.1f (%d)\n",
 		       tx, tx_name[tx], st->success, st->late, st->retry, st->failure,
-		       total_rt[tx] / (st->success + st->late), rt_limit[tx]);
+		       hist_total_mean(tx), rt_limit[tx]);
 	}
 
+	printf("\n<Thread Times (sec.)>\n");
+	printf("  thread      wall       cpu  measure_wall  measure_cpu   cpu%%  lock_wait  lock%%\n");
+	for (k = 0; k < num_conn; k++) {
+		thread_time_t *tt = &thd_arg[k].time;
+		printf("  %6d %9.3f %9.3f     %9.3f    %9.3f %6.1f  %9.3f %6.1f\n",
+		       k, tt->wall, tt->cpu, tt->measure_wall, tt->measure_cpu,
+		       tt->measure_wall > 0 ?
+			       100.0 * tt->measure_cpu / tt->measure_wall :
+			       0.0,
+		       tt->measure_lock_wait,
+		       tt->measure_wall > 0 ?
+			       100.0 * tt->measure_lock_wait / tt->measure_wall :
+			       0.0);
+	}
+
+	for (k = 0, j = 0; k < num_conn; k++)
+		j += thd_arg[k].step_retries;
+	printf("  statements stepped again after SQLITE_BUSY: %ld\n", j);
+
+	report_affinity_groups(thd_arg);
+	errstat_report();
+	cost_report(&g_stats);
+	if (stmtprof_on)
+		stmtprof_report();
+	if (ckpt_on)
+		ckpt_report();
+	if (iovfs_on)
+		iovfs_report();
+	if (shared_nothing)
+		remote_report();
+	if (slowlog_on && slowlog_write())
+		fprintf(stderr, "error at slowlog_write()\n");
+	if (group_commit)
+		gcommit_report();
+	if (ro_pool_size > 0)
+		ro_pool_report();
+
+	free(thd_arg);
+	counters_done();
+	errstat_done();
+	cost_done();
+	txphase_done();
+	if (slowlog_on)
+		slowlog_done();
+	if (shared_nothing)
+		remote_done();
+	if (writer_admission)
+		admission_done();
+
 	// Checks
 	check_constraints_and_response_times();
 
 	printf("\n<TpmC>\n");
-	f = (float)(g_stats.stat[0].success + g_stats.stat[0].late) * 60.0 /
-	    (float)((measure_time / PRINT_INTERVAL) * PRINT_INTERVAL);
+	f = time_taken > 0 ?
+		    (g_stats.stat[0].success + g_stats.stat[0].late) * 60.0 /
+			    time_taken :
+		    0.0;
 	printf("                 %.3f TpmC\n", f);
 
 	printf("\nTime taken\n");
-	time_taken = ((double)(time_end - time_start)) / CLOCKS_PER_SEC;
 	printf("                 %.3f seconds\n", time_taken);
 
 	exit(0);
@@ -473,63 +938,78 @@ sqlerr:
 void alarm_handler(int signum)
 {
 	int i;
-	int s[5], l[5];
-	double rt90[5];
-	double trt[5];
+	uint64_t s[5], l[5];
+	double max[5];
 	double percentile_val;
 	double percentile_val99;
 
+	counters_collect(&g_stats);
 	for (i = 0; i < 5; i++) {
 		s[i] = g_stats.stat[i].success;
 		l[i] = g_stats.stat[i].late;
-		trt[i] = total_rt[i];
-		//rt90[i] = hist_ckp(i);
 	}
 
 	time_count += PRINT_INTERVAL;
+	hist_ckp();
+	for (i = 0; i < 5; i++)
+		max[i] = hist_max(i);
+	sb_percentile_checkpoint(&local_percentile);
 	percentile_val = sb_percentile_calculate(&local_percentile, 95);
 	percentile_val99 = sb_percentile_calculate(&local_percentile, 99);
-	sb_percentile_reset(&local_percentile);
 	//  printf("%4d, %d:%.3f|%.3f(%.3f), %d:%.3f|%.3f(%.3f), %d:%.3f|%.3f(%.3f), %d:%.3f|%.3f(%.3f), %d:%.3f|%.3f(%.3f)\n",
-	printf("%4d, trx: %d, 95%: %.3f, 99%: %.3f, max_rt: %.3f, %d|%.3f, %d|%.3f, %d|%.3f, %d|%.3f\n",
+	printf("%4d, trx: %lu, 95%: %.3f, 99%: %.3f, max_rt: %.3f, %lu|%.3f, %lu|%.3f, %lu|%.3f, %lu|%.3f\n",
 	       time_count, (s[0] + l[0] - prev_s[0] - prev_l[0]),
-	       percentile_val, percentile_val99, (double)cur_max_rt[0],
-	       (s[1] + l[1] - prev_s[1] - prev_l[1]), (double)cur_max_rt[1],
-	       (s[2] + l[2] - prev_s[2] - prev_l[2]), (double)cur_max_rt[2],
-	       (s[3] + l[3] - prev_s[3] - prev_l[3]), (double)cur_max_rt[3],
-	       (s[4] + l[4] - prev_s[4] - prev_l[4]), (double)cur_max_rt[4]);
+	       percentile_val, percentile_val99, max[0],
+	       (s[1] + l[1] - prev_s[1] - prev_l[1]), max[1],
+	       (s[2] + l[2] - prev_s[2] - prev_l[2]), max[2],
+	       (s[3] + l[3] - prev_s[3] - prev_l[3]), max[3],
+	       (s[4] + l[4] - prev_s[4] - prev_l[4]), max[4]);
 	fflush(stdout);
 
 	for (i = 0; i < 5; i++) {
 		prev_s[i] = s[i];
 		prev_l[i] = l[i];
-		prev_total_rt[i] = trt[i];
-		cur_max_rt[i] = 0.0;
 	}
 }
 
 void alarm_dummy()
 {
 	int i;
-	int s[5], l[5];
-	float rt90[5];
+	uint64_t s[5], l[5];
+	double rt99[5];
 
+	counters_collect(&g_stats);
 	for (i = 0; i < 5; i++) {
 		s[i] = g_stats.stat[i].success;
 		l[i] = g_stats.stat[i].late;
-		rt90[i] = hist_ckp(i);
 	}
+	hist_ckp();
+	for (i = 0; i < 5; i++)
+		rt99[i] = hist_percentile(i, 99.0);
+	sb_percentile_checkpoint(&local_percentile);
 
 	time_count += PRINT_INTERVAL;
-	printf("%4d, %d(%d):%.2f, %d(%d):%.2f, %d(%d):%.2f, %d(%d):%.2f, %d(%d):%.2f\n",
+	printf("%4d, %lu(%lu):%.2f, %lu(%lu):%.2f, %lu(%lu):%.2f, %lu(%lu):%.2f, %lu(%lu):%.2f\n",
 	       time_count, (s[0] + l[0] - prev_s[0] - prev_l[0]),
-	       (l[0] - prev_l[0]), rt90[0],
+	       (l[0] - prev_l[0]), rt99[0],
 	       (s[1] + l[1] - prev_s[1] - prev_l[1]), (l[1] - prev_l[1]),
-	       rt90[1], (s[2] + l[2] - prev_s[2] - prev_l[2]),
-	       (l[2] - prev_l[2]), rt90[2],
+	       rt99[1], (s[2] + l[2] - prev_s[2] - prev_l[2]),
+	       (l[2] - prev_l[2]), rt99[2],
 	       (s[3] + l[3] - prev_s[3] - prev_l[3]), (l[3] - prev_l[3]),
-	       rt90[3], (s[4] + l[4] - prev_s[4] - prev_l[4]),
-	       (l[4] - prev_l[4]), rt90[4]);
+	       rt99[3], (s[4] + l[4] - prev_s[4] - prev_l[4]),
+	       (l[4] - prev_l[4]), rt99[4]);
+	for (i = 0; i < 5; i++)
+		printf("      %-12s p50: %.3f, p95: %.3f, p99: %.3f, p99.9: %.3f, max: %.3f\n",
+		       tx_name[i], hist_percentile(i, 50.0),
+		       hist_percentile(i, 95.0), rt99[i],
+		       hist_percentile(i, 99.9), hist_max(i));
+	errstat_interval();
+	if (slowlog_on)
+		slowlog_interval();
+	if (ckpt_on)
+		ckpt_interval();
+	if (iovfs_on)
+		iovfs_interval();
 	fflush(stdout);
 
 	for (i = 0; i < 5; i++) {
@@ -577,60 +1057,328 @@ static inline const char *sql_statements[] =
 	"SELECT count(*) FROM stock WHERE s_w_id = ? AND s_i_id = ? AND s_quantity < ?",
 };
 
-int thread_main(thread_arg *arg)
+_Static_assert(sizeof(sql_statements) / sizeof(sql_statements[0]) ==
+		       NUM_SQL_STATEMENTS,
+	       "NUM_SQL_STATEMENTS out of date");
+
+/* prepare one set of sql_statements[] per shard, in shard order */
+static int prepare_statements(thread_arg *arg)
+{
+	char *sql;
+	int k, i, rc;
+
+	for (k = 0; k < shard_sets(); k++) {
+		/* shared-nothing: only the thread's own shard is attached */
+		if (shared_nothing && k != arg->number)
+			continue;
+		for (i = 0; i < NUM_SQL_STATEMENTS; i++) {
+			sql = shard_sql(sql_statements[i], k);
+			rc = sqlite3_prepare_v2(arg->ctx, sql, -1,
+						&arg->stmt[k * NUM_SQL_STATEMENTS + i],
+						NULL);
+			sqlite3_free(sql);
+			if (rc != SQLITE_OK)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+/* query plans for the statement profile */
+static int explain_statements(void)
+{
+	return stmtprof_explain(dbpath, sql_statements, NUM_SQL_STATEMENTS);
+}
+
+/*
+ * open loop: sleep until the next scheduled arrival and remember it as
+ * the intended start, so latency includes any time spent behind
+ * schedule (no coordinated omission). returns 1 when told to stop.
+ */
+static int sleep_until(thread_arg *arg, double when)
+{
+	double now, u;
+	struct timespec ts;
+
+	while ((now = clock_sec(CLOCK_MONOTONIC)) < when) {
+		if (get_phase() == PHASE_STOP)
+			return 1;
+		/* wake up at least every 100ms to notice the stop */
+		u = when - now;
+		if (u > 0.1)
+			u = 0.1;
+		/* shared-nothing: others wait for us, keep serving them */
+		if (arg->remote && remote_serve(arg->number, arg))
+			continue;
+		if (arg->remote && u > 0.0002)
+			u = 0.0002;
+		ts.tv_sec = (time_t)u;
+		ts.tv_nsec = (long)((u - ts.tv_sec) * 1000000000.0);
+		nanosleep(&ts, NULL);
+	}
+	return 0;
+}
+
+static void set_intended(thread_arg *arg, double when)
+{
+	arg->intended.tv_sec = (time_t)when;
+	arg->intended.tv_nsec = (long)((when - arg->intended.tv_sec) * 1000000000.0);
+}
+
+static int wait_arrival(thread_arg *arg)
+{
+	double u;
+
+	if (sleep_until(arg, arg->next_arrival))
+		return 1;
+	set_intended(arg, arg->next_arrival);
+
+	if (arrival_dist == ARRIVAL_POISSON) {
+		/* exponential inter-arrival, u in (0, 1] */
+		u = ((rnd_next(&arg->rnd) >> 11) + 1) * (1.0 / 9007199254740992.0);
+		arg->next_arrival += -log(u) / arg->rate;
+	} else {
+		arg->next_arrival += 1.0 / arg->rate;
+	}
+	return 0;
+}
+
+/*
+ * open the connection of a thread and prepare its statements. a
+ * read-only one gets its busy handler from whoever borrows it.
+ */
+static int db_connect(thread_arg *arg, int readonly)
 {
 	int t_num = arg->number;
-	int r, i;
 	sqlite3 *sqlite3_db = NULL;
 
-	/* EXEC SQL WHENEVER SQLERROR GOTO sqlerr;*/
-
 	// printf("Using schema: %s\n", db_string_full);
 
 	/* exec sql connect :connect_string; */
 	printf("%s: opening db=%s, thread id = %lu\n", __func__, dbpath, pthread_self());
-	sqlite3_open(dbpath, &sqlite3_db);
+	sqlite3_open_v2(dbpath, &sqlite3_db,
+			readonly ? SQLITE_OPEN_READONLY :
+				   SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+			NULL);
 	if (!sqlite3_db) {
 		printf("%s: Failed to open DB=%s\n", __func__, dbpath);
 	}
 	printf("%s: opened db=%s, thread id = %lu\n", __func__, dbpath, pthread_self());
 
-	sqlite3_exec(sqlite3_db, "PRAGMA journal_mode = WAL;", 0, 0, 0);
-
 	if (!sqlite3_db) {
-		goto sqlerr;
+		return 1;
 	}
 
 	arg->ctx = sqlite3_db;
+	if (!readonly)
+		busy_install(arg);
+
+	/* shards first, so that the profile applies to them too */
+	if (shared_nothing ? shard_attach_one(sqlite3_db, dbpath, t_num) :
+			     shard_attach(sqlite3_db, dbpath))
+		return 1;
+
+	if (profile_apply(sqlite3_db, readonly))
+		return 1;
+	/* after the profile, whose wal_autocheckpoint would undo it */
+	if (!readonly)
+		ckpt_install(sqlite3_db);
+	if (readonly)
+		sqlite3_exec(sqlite3_db, "PRAGMA query_only = 1;", 0, 0, 0);
 
 	/* Prepare ALL of SQLs */
-	for (int i = 0; i < 35; ++i) {
-		if (sqlite3_prepare_v2(sqlite3_db, sql_statements[i], -1, &arg->stmt[i], NULL) != SQLITE_OK)
-			goto sqlerr;
+	if (prepare_statements(arg) || tx_ctl_prepare(arg))
+		return 1;
+	if (stmtprof_install(sqlite3_db, arg->stmt))
+		return 1;
+
+	return 0;
+}
+
+/* open every connection of the read-only pool */
+static int ro_pool_open(void)
+{
+	thread_arg tmp;
+	ro_conn_t *c;
+	int i;
+
+	if (ro_pool_init())
+		return 1;
+	for (i = 0; i < ro_pool_size; i++) {
+		memset(&tmp, 0, sizeof(tmp));
+		tmp.number = -1;
+		tmp.stmt = calloc(shard_sets() * NUM_SQL_STATEMENTS,
+				  sizeof(sqlite3_stmt *));
+		c = ro_pool_slot(i);
+		c->stmt = tmp.stmt;
+		if (db_connect(&tmp, 1)) {
+			printf("%s: error: %s\n", __func__,
+			       tmp.ctx ? sqlite3_errmsg(tmp.ctx) : "open failed");
+			return 1;
+		}
+		c->ctx = tmp.ctx;
+		memcpy(c->ctl, tmp.ctl, sizeof(c->ctl));
 	}
+	return 0;
+}
+
+static void ro_pool_close(void)
+{
+	ro_conn_t *c;
+	int i, k;
+
+	for (i = 0; i < ro_pool_size; i++) {
+		c = ro_pool_slot(i);
+		stmtprof_collect(c->stmt);
+		for (k = 0; k < shard_sets() * NUM_SQL_STATEMENTS; k++)
+			sqlite3_finalize(c->stmt[k]);
+		for (k = 0; k < CTL_NUMS; k++)
+			sqlite3_finalize(c->ctl[k]);
+		sqlite3_close(c->ctx);
+		free(c->stmt);
+	}
+	ro_pool_done();
+}
+
+static void *writer_main(void *p)
+{
+	thread_arg *arg = p;
+	int i;
+
+	if (db_connect(arg, 0)) {
+		printf("%s: error: %s\n", __func__,
+		       arg->ctx ? sqlite3_errmsg(arg->ctx) : "open failed");
+		exit(1);
+	}
+	gcommit_run(arg);
+
+	stmtprof_collect(arg->stmt);
+	for (i = 0; i < shard_sets() * NUM_SQL_STATEMENTS; i++)
+		sqlite3_finalize(arg->stmt[i]);
+	tx_ctl_finalize(arg);
+	sqlite3_close(arg->ctx);
+	return NULL;
+}
+
+int thread_main(thread_arg *arg)
+{
+	int t_num = arg->number;
+	int r = 0, i;
+	int started = 0, phase;
+	term_sched_t *sched = NULL;
+	terminal_t *term;
+	tx_input_t input, *in;
+	double now, wake;
+	double wall0, cpu0, mwall0 = 0.0, mcpu0 = 0.0, mlock0 = 0.0;
+	int measured = 0;
+
+	/* EXEC SQL WHENEVER SQLERROR GOTO sqlerr;*/
+
+	if (db_connect(arg, 0))
+		goto sqlerr;
+
+	if (affinity_bind(&arg->aff))
+		fprintf(stderr, "thread %d: could not bind to node %d\n", t_num,
+			arg->aff.node);
 
 	INITIALIZE_TIMERS();
 
-	time_start = clock();
+	pthread_barrier_wait(&start_barrier);
+	started = 1;
+	arg->time.lock_wait = 0.0; /* from the start line on */
+	arg->step_retries = 0;
+	wall0 = clock_sec(CLOCK_MONOTONIC);
+	cpu0 = clock_sec(CLOCK_THREAD_CPUTIME_ID);
+	arg->next_arrival = wall0;
+	if (terminal_mode) {
+		sched = term_sched_new(arg, t_num, wall0);
+		if (sched == NULL) {
+			fprintf(stderr, "error at term_sched_new()\n");
+			goto out;
+		}
+	}
 
-	for (i = 0; i < num_trans; i++) {
-		if (sqlite3_exec(sqlite3_db, "BEGIN TRANSACTION;", NULL, NULL, NULL) != SQLITE_OK)
-			goto sqlerr;
+	i = 0;
+	while (num_trans == 0 || i < num_trans) {
+		phase = get_phase();
+		if (phase == PHASE_STOP)
+			break;
+		/* note the edges of the measurement window as they pass by */
+		if (phase == PHASE_MEASURE && !measured) {
+			mwall0 = clock_sec(CLOCK_MONOTONIC);
+			mcpu0 = clock_sec(CLOCK_THREAD_CPUTIME_ID);
+			mlock0 = arg->time.lock_wait;
+			measured = 1;
+		} else if (phase != PHASE_MEASURE && measured == 1) {
+			arg->time.measure_wall = clock_sec(CLOCK_MONOTONIC) - mwall0;
+			arg->time.measure_cpu =
+				clock_sec(CLOCK_THREAD_CPUTIME_ID) - mcpu0;
+			arg->time.measure_lock_wait = arg->time.lock_wait - mlock0;
+			measured = 2;
+		}
+
+		if (arg->remote)
+			remote_serve(t_num, arg);
+
+		if (terminal_mode) {
+			/* step terminals until one has a tx keyed in */
+			now = clock_sec(CLOCK_MONOTONIC);
+			term = term_sched_next(sched, now, &wake);
+			if (term == NULL) {
+				if (sleep_until(arg, wake))
+					break;
+				continue;
+			}
+			if (term->state == TERM_THINKING) {
+				term_key_next(term, arg, t_num);
+				term_sched_add(sched, term);
+				continue;
+			}
+			set_intended(arg, term->due);
+			in = &term->input;
+		} else {
+			if (arg->rate > 0 && wait_arrival(arg))
+				break;
+			/* closed loop / open loop: key in right away */
+			tx_input_gen(arg, t_num, seq_get(arg->deck), 0, 0, &input);
+			in = &input;
+		}
 
-		r = driver(t_num, arg);
+		/* BEGIN/COMMIT per attempt, inside */
+		r = tx_execute(t_num, arg, in);
+		i++;
 
-		/* EXEC SQL COMMIT WORK; */
-		if (sqlite3_exec(sqlite3_db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
-			goto sqlerr;
+		if (terminal_mode) {
+			term_think(term, &arg->rnd, clock_sec(CLOCK_MONOTONIC));
+			term_sched_add(sched, term);
+		}
+	}
+
+out:
+	/* stopped (or hit the -t cap) inside the window */
+	if (measured == 1) {
+		arg->time.measure_wall = clock_sec(CLOCK_MONOTONIC) - mwall0;
+		arg->time.measure_cpu = clock_sec(CLOCK_THREAD_CPUTIME_ID) - mcpu0;
+		arg->time.measure_lock_wait = arg->time.lock_wait - mlock0;
 	}
+	arg->time.wall = clock_sec(CLOCK_MONOTONIC) - wall0;
+	arg->time.cpu = clock_sec(CLOCK_THREAD_CPUTIME_ID) - cpu0;
+
+	if (arg->remote)
+		remote_leave(t_num, arg);
+	if (slowlog_on)
+		slowlog_flush(arg);
 
 	PRINT_TIME();
 
-	time_end = clock();
+	if (sched)
+		term_sched_free(sched);
 
-	for (i = 0; i < 40; i++) {
-		sqlite3_reset(arg->stmt[i]);
+	stmtprof_collect(arg->stmt);
+	for (i = 0; i < shard_sets() * NUM_SQL_STATEMENTS; i++) {
+		sqlite3_finalize(arg->stmt[i]);
 	}
+	tx_ctl_finalize(arg);
 
 	/* EXEC SQL DISCONNECT; */
 	sqlite3_close(arg->ctx);
@@ -643,7 +1391,55 @@ int thread_main(thread_arg *arg)
 sqlerr:
 	fprintf(stdout, "error at thread_main\n");
 	printf("%s: error: %s\n", __func__, sqlite3_errmsg(arg->ctx));
+	/* do not leave main() waiting at the start line */
+	if (!started)
+		pthread_barrier_wait(&start_barrier);
+	/* others may still ship to us */
+	if (arg->remote && arg->ctx) {
+		if (!sqlite3_get_autocommit(arg->ctx))
+			sqlite3_exec(arg->ctx, "ROLLBACK;", NULL, NULL, NULL);
+		remote_leave(t_num, arg);
+	}
 
 	//error(ctx[t_num],0);
 	return (0);
 }
+
+/*
+ * contention per affinity group: retries are lock conflicts (BUSY)
+ * that made a tx start over, failures ran out of retries
+ */
+static void report_affinity_groups(thread_arg *thd_arg)
+{
+	int ngroups = affinity_num_groups(num_conn, num_ware);
+	int g, k, tx, threads;
+	uint64_t done, retry, failure;
+	thread_arg *first;
+
+	printf("\n<Affinity Groups (%s)>\n", affinity_name());
+	printf("  group threads  warehouses        tx   retries  failures  retry%%\n");
+	for (g = 0; g < ngroups; g++) {
+		threads = 0;
+		done = retry = failure = 0;
+		first = NULL;
+		for (k = 0; k < num_conn; k++) {
+			tx_stat_t *st = thd_arg[k].counters->stats.stat;
+
+			if (thd_arg[k].aff.group != g)
+				continue;
+			if (first == NULL)
+				first = &thd_arg[k];
+			threads++;
+			for (tx = 0; tx < TX_NUMS; tx++) {
+				done += st[tx].success + st[tx].late;
+				retry += st[tx].retry;
+				failure += st[tx].failure;
+			}
+		}
+		if (first == NULL)
+			continue;
+		printf("  %5d %7d %5d-%-5d %10lu %9lu %9lu %7.2f\n", g, threads,
+		       first->aff.w_lo, first->aff.w_hi, done, retry, failure,
+		       done + retry ? 100.0 * retry / (done + retry) : 0.0);
+	}
+}
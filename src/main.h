@@ -3,9 +3,19 @@
 #include <pthread.h>
 #include <fcntl.h>
 #include <time.h>
+#include <stdint.h>
 
 #include <sqlite3.h>
 
+#include "tpc.h"
+#include "affinity.h"
+#include "shard.h"
+
+#define CACHE_LINE_SIZE 64
+
+/* sql_statements[] in main.c, prepared once per shard */
+#define NUM_SQL_STATEMENTS 35
+
 
 enum tx_type {
 	TX_NEWORD,
@@ -17,24 +27,150 @@ enum tx_type {
 };
 
 
+/* slots of the per-phase breakdown of one tx, see txphase.h */
+#define TX_PHASES 8
+
+/* per-phase clock of the attempt a thread is running */
+typedef struct {
+	int tx; /* -1: not timing */
+	int cur; /* phase being timed */
+	unsigned seen; /* phases entered so far */
+	int64_t t0; /* nsec., start of cur */
+	int64_t ns[TX_PHASES]; /* time spent in each phase */
+} tx_clock_t;
+
 typedef struct {
-	int success;
-	int late;
-	int retry;
-	int failure;
+	uint64_t success;
+	uint64_t late;
+	uint64_t retry;
+	uint64_t failure;
 } tx_stat_t;
 
 typedef struct {
 	tx_stat_t stat[TX_NUMS];
 } all_tx_stat_t;
 
+/*
+ * terminal input of one transaction, generated before it runs (keying)
+ * so a terminal can be parked between input and execution
+ */
+typedef struct {
+	int tx;
+	int w_id;
+	int d_id;
+	union {
+		struct {
+			int c_id;
+			int ol_cnt;
+			int all_local;
+			int itemid[MAX_NUM_ITEMS];
+			int supware[MAX_NUM_ITEMS];
+			int qty[MAX_NUM_ITEMS];
+		} neword;
+		struct {
+			int byname;
+			int c_w_id;
+			int c_d_id;
+			int c_id;
+			int h_amount;
+			char c_last[17];
+		} payment;
+		struct {
+			int byname;
+			int c_id;
+			char c_last[17];
+		} ordstat;
+		struct {
+			int o_carrier_id;
+		} delivery;
+		struct {
+			int level;
+		} slev;
+	};
+} tx_input_t;
+
+/*
+ * transaction control statements, prepared once per connection. the
+ * BEGIN flavours double as the values of begin_mode[].
+ */
+enum tx_ctl {
+	CTL_DEFERRED,
+	CTL_IMMEDIATE,
+	CTL_EXCLUSIVE,
+	CTL_COMMIT,
+	CTL_ROLLBACK,
+	CTL_SAVEPOINT, /* group commit: one per tx of a batch */
+	CTL_ROLLBACK_TO,
+	CTL_RELEASE,
+	CTL_NUMS
+};
+
+extern int begin_mode[TX_NUMS];
+
+/* derived view, refreshed from the per-thread counters by the reporter */
 extern all_tx_stat_t g_stats;
-extern all_tx_stat_t* stats_per_thread;
+
+/* run phases, driven by main() and polled by the workers */
+enum run_phase {
+	PHASE_RAMPUP,
+	PHASE_MEASURE,
+	PHASE_RAMPDOWN,
+	PHASE_STOP
+};
+
+extern int run_phase;
+
+static inline int get_phase(void)
+{
+	return __atomic_load_n(&run_phase, __ATOMIC_ACQUIRE);
+}
+
+static inline double clock_sec(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/* open-loop arrival process */
+enum arrival_dist {
+	ARRIVAL_POISSON,
+	ARRIVAL_CONSTANT
+};
+
+/* per-thread time accounting, in seconds */
+typedef struct {
+	double wall; /* whole run, from the start barrier */
+	double cpu;
+	double measure_wall; /* inside the measurement window */
+	double measure_cpu;
+	double lock_wait; /* admission queue and busy handler */
+	double measure_lock_wait;
+} thread_time_t;
 
 typedef struct {
 	int number;
 	pthread_t pth;
-	all_tx_stat_t stats;
+	struct tx_counters *counters;
+	struct seq_deck *deck;
 	sqlite3 *ctx;
 	sqlite3_stmt **stmt;
-} thread_arg;
+	sqlite3_stmt *ctl[CTL_NUMS];
+	sqlite3_stmt **wlock; /* per shard, takes its write lock; NULL: none */
+	thread_time_t time;
+	double rate; /* arrivals/sec, 0: closed loop */
+	double next_arrival; /* CLOCK_MONOTONIC sec. */
+	int scheduled; /* measure latency from intended, not from start */
+	struct timespec intended; /* scheduled start of the current tx */
+	affinity_t aff; /* home warehouse range */
+	struct remote_ctx *remote; /* shared-nothing mode, else NULL */
+	double busy_since; /* start of the current busy wait */
+	uint64_t step_retries; /* statements stepped again by tx_step() */
+	tx_clock_t txp; /* -E: phases of the running attempt */
+	rnd_ctx_t rnd; /* written on every draw, keep on own cache line */
+	rnd_ctx_t backoff_rnd; /* busy handler jitter, apart from the tx input */
+} __attribute__((aligned(CACHE_LINE_SIZE))) thread_arg;
+
+/* statement i of the set prepared against the shard owning warehouse w */
+#define STMT(arg, i, w) ((arg)->stmt[shard_of(w) * NUM_SQL_STATEMENTS + (i)])
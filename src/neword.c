@@ -13,6 +13,11 @@
 #include "spt_proc.h"
 #include "tpc.h"
 #include "main.h"
+#include "lockwait.h"
+#include "errstat.h"
+#include "txphase.h"
+#include "remote.h"
+#include "trans_if.h"
 
 #define pick_dist_info(ol_dist_info, ol_supply_w_id)  \
 	switch (ol_supply_w_id) {                     \
@@ -51,6 +56,111 @@
 
 #define NNULL ((void *)0)
 
+/*
+ * read and update the stock row of one supply line. in shared-nothing
+ * mode the owner of a remote supplying warehouse runs it for the
+ * ordering thread.
+ */
+int neword_stock(int t_num, thread_arg *arg, remote_stock_t *rs)
+{
+	int ret;
+	int s_quantity = 0;
+	char s_dist_01[25];
+	char s_dist_02[25];
+	char s_dist_03[25];
+	char s_dist_04[25];
+	char s_dist_05[25];
+	char s_dist_06[25];
+	char s_dist_07[25];
+	char s_dist_08[25];
+	char s_dist_09[25];
+	char s_dist_10[25];
+	int proceed;
+
+	sqlite3_stmt *sqlite_stmt;
+	int num_cols;
+
+	rs->s_data[0] = '\0';
+	rs->dist_info[0] = '\0';
+
+	proceed = 7;
+	/*EXEC_SQL SELECT s_quantity, s_data, s_dist_01, s_dist_02,
+	                s_dist_03, s_dist_04, s_dist_05, s_dist_06,
+	                s_dist_07, s_dist_08, s_dist_09, s_dist_10
+		INTO :s_quantity, :s_data, :s_dist_01, :s_dist_02,
+	             :s_dist_03, :s_dist_04, :s_dist_05, :s_dist_06,
+	             :s_dist_07, :s_dist_08, :s_dist_09, :s_dist_10
+	        FROM stock
+	        WHERE s_i_id = :ol_i_id
+		AND s_w_id = :ol_supply_w_id
+		FOR UPDATE;*/
+
+	sqlite_stmt = STMT(arg, 6, rs->w_id);
+
+	sqlite3_bind_int64(sqlite_stmt, 1, rs->i_id);
+	sqlite3_bind_int64(sqlite_stmt, 2, rs->w_id);
+
+	ret = tx_step(arg, sqlite_stmt);
+	if (ret != SQLITE_DONE) {
+		if (ret != SQLITE_ROW)
+			goto sqlerr;
+		num_cols = sqlite3_column_count(sqlite_stmt);
+		if (num_cols != 12)
+			goto sqlerr;
+
+		s_quantity = sqlite3_column_int64(sqlite_stmt, 0);
+		strcpy(rs->s_data, sqlite3_column_text(sqlite_stmt, 1));
+		strcpy(s_dist_01, sqlite3_column_text(sqlite_stmt, 2));
+		strcpy(s_dist_02, sqlite3_column_text(sqlite_stmt, 3));
+		strcpy(s_dist_03, sqlite3_column_text(sqlite_stmt, 4));
+		strcpy(s_dist_04, sqlite3_column_text(sqlite_stmt, 5));
+		strcpy(s_dist_05, sqlite3_column_text(sqlite_stmt, 6));
+		strcpy(s_dist_06, sqlite3_column_text(sqlite_stmt, 7));
+		strcpy(s_dist_07, sqlite3_column_text(sqlite_stmt, 8));
+		strcpy(s_dist_08, sqlite3_column_text(sqlite_stmt, 9));
+		strcpy(s_dist_09, sqlite3_column_text(sqlite_stmt, 10));
+		strcpy(s_dist_10, sqlite3_column_text(sqlite_stmt, 11));
+
+		pick_dist_info(rs->dist_info, rs->d_id); /* pick correct
+							  * s_dist_xx */
+	}
+
+	sqlite3_reset(sqlite_stmt);
+
+	rs->s_quantity = s_quantity;
+	if (s_quantity > rs->qty)
+		s_quantity = s_quantity - rs->qty;
+	else
+		s_quantity = s_quantity - rs->qty + 91;
+
+#ifdef DEBUG
+	printf("n %d\n", proceed);
+#endif
+
+	proceed = 8;
+	/*EXEC_SQL UPDATE stock SET s_quantity = :s_quantity
+	        WHERE s_i_id = :ol_i_id
+		AND s_w_id = :ol_supply_w_id;*/
+
+	sqlite_stmt = STMT(arg, 7, rs->w_id);
+
+	sqlite3_bind_int64(sqlite_stmt, 1, s_quantity);
+	sqlite3_bind_int64(sqlite_stmt, 2, rs->i_id);
+	sqlite3_bind_int64(sqlite_stmt, 3, rs->w_id);
+
+	if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
+		goto sqlerr;
+
+	sqlite3_reset(sqlite_stmt);
+
+	return (1);
+
+sqlerr:
+	tx_error(arg, TX_NEWORD, proceed);
+	sqlite3_reset(sqlite_stmt);
+	return (0);
+}
+
 /*
  * the new order transaction
  */
@@ -85,23 +195,13 @@ int neword(int t_num, thread_arg *arg,
 	int ol_i_id;
 	int s_quantity;
 	char s_data[51];
-	char s_dist_01[25];
-	char s_dist_02[25];
-	char s_dist_03[25];
-	char s_dist_04[25];
-	char s_dist_05[25];
-	char s_dist_06[25];
-	char s_dist_07[25];
-	char s_dist_08[25];
-	char s_dist_09[25];
-	char s_dist_10[25];
 	char ol_dist_info[25];
 	int ol_supply_w_id;
 	float ol_amount;
 	int ol_number;
 	int ol_quantity;
+	remote_stock_t local_stock, *rs;
 
-	char iname[MAX_NUM_ITEMS][MAX_ITEM_LEN];
 	char bg[MAX_NUM_ITEMS];
 	float amt[MAX_NUM_ITEMS];
 	float price[MAX_NUM_ITEMS];
@@ -128,6 +228,7 @@ int neword(int t_num, thread_arg *arg,
 	clk_start = clock_gettime(CLOCK_REALTIME, &tbuf_start);
 
 	proceed = 1;
+	txphase_mark(arg, TXP_NO_CUSTWARE);
 	/*EXEC_SQL SELECT c_discount, c_last, c_credit, w_tax
 		INTO :c_discount, :c_last, :c_credit, :w_tax
 	        FROM customer, warehouse
@@ -135,13 +236,13 @@ int neword(int t_num, thread_arg *arg,
 		AND c_w_id = w_id
 		AND c_d_id = :d_id
 		AND c_id = :c_id;*/
-	sqlite_stmt = arg->stmt[0];
+	sqlite_stmt = STMT(arg, 0, w_id);
 
 	sqlite3_bind_int64(sqlite_stmt, 1, w_id);
 	sqlite3_bind_int64(sqlite_stmt, 2, d_id);
 	sqlite3_bind_int64(sqlite_stmt, 3, c_id);
 
-	ret = sqlite3_step(sqlite_stmt);
+	ret = tx_step(arg, sqlite_stmt);
 	if (ret != SQLITE_DONE) {
 		if (ret != SQLITE_ROW)
 			goto sqlerr;
@@ -162,18 +263,19 @@ int neword(int t_num, thread_arg *arg,
 #endif
 
 	proceed = 2;
+	txphase_mark(arg, TXP_NO_DISTRICT);
 	/*EXEC_SQL SELECT d_next_o_id, d_tax INTO :d_next_o_id, :d_tax
 	        FROM district
 	        WHERE d_id = :d_id
 		AND d_w_id = :w_id
 		FOR UPDATE;*/
 
-	sqlite_stmt = arg->stmt[1];
+	sqlite_stmt = STMT(arg, 1, w_id);
 
 	sqlite3_bind_int64(sqlite_stmt, 1, d_id);
 	sqlite3_bind_int64(sqlite_stmt, 2, w_id);
 
-	ret = sqlite3_step(sqlite_stmt);
+	ret = tx_step(arg, sqlite_stmt);
 	if (ret != SQLITE_DONE) {
 		if (ret != SQLITE_ROW)
 			goto sqlerr;
@@ -192,13 +294,13 @@ int neword(int t_num, thread_arg *arg,
 	        WHERE d_id = :d_id
 		AND d_w_id = :w_id;*/
 
-	sqlite_stmt = arg->stmt[2];
+	sqlite_stmt = STMT(arg, 2, w_id);
 
 	sqlite3_bind_int64(sqlite_stmt, 1, d_next_o_id);
 	sqlite3_bind_int64(sqlite_stmt, 2, d_id);
 	sqlite3_bind_int64(sqlite_stmt, 3, w_id);
 
-	if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+	if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 		goto sqlerr;
 
 	sqlite3_reset(sqlite_stmt);
@@ -210,13 +312,14 @@ int neword(int t_num, thread_arg *arg,
 #endif
 
 	proceed = 4;
+	txphase_mark(arg, TXP_NO_ORDER);
 	/*EXEC_SQL INSERT INTO orders (o_id, o_d_id, o_w_id, o_c_id,
 			             o_entry_d, o_ol_cnt, o_all_local)
 		VALUES(:o_id, :d_id, :w_id, :c_id,
 		       :datetime,
                        :o_ol_cnt, :o_all_local);*/
 
-	sqlite_stmt = arg->stmt[3];
+	sqlite_stmt = STMT(arg, 3, w_id);
 
 	sqlite3_bind_int64(sqlite_stmt, 1, o_id);
 	sqlite3_bind_int64(sqlite_stmt, 2, d_id);
@@ -226,7 +329,7 @@ int neword(int t_num, thread_arg *arg,
 	sqlite3_bind_int64(sqlite_stmt, 6, o_ol_cnt);
 	sqlite3_bind_int64(sqlite_stmt, 7, o_all_local);
 
-	if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+	if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 		goto sqlerr;
 
 	sqlite3_reset(sqlite_stmt);
@@ -238,13 +341,13 @@ int neword(int t_num, thread_arg *arg,
 	/* EXEC_SQL INSERT INTO new_orders (no_o_id, no_d_id, no_w_id)
 	   VALUES (:o_id,:d_id,:w_id); */
 
-	sqlite_stmt = arg->stmt[4];
+	sqlite_stmt = STMT(arg, 4, w_id);
 
 	sqlite3_bind_int64(sqlite_stmt, 1, o_id);
 	sqlite3_bind_int64(sqlite_stmt, 2, d_id);
 	sqlite3_bind_int64(sqlite_stmt, 3, w_id);
 
-	if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+	if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 		goto sqlerr;
 
 	sqlite3_reset(sqlite_stmt);
@@ -278,6 +381,8 @@ int neword(int t_num, thread_arg *arg,
 		ol_i_id = itemid[ol_num_seq[ol_number - 1]];
 		ol_quantity = qty[ol_num_seq[ol_number - 1]];
 
+		txphase_mark(arg, TXP_NO_ITEM);
+
 		/* EXEC SQL WHENEVER NOT FOUND GOTO invaliditem; */
 		proceed = 6;
 		/*EXEC_SQL SELECT i_price, i_name, i_data
@@ -285,11 +390,11 @@ int neword(int t_num, thread_arg *arg,
 		        FROM item
 		        WHERE i_id = :ol_i_id;*/
 
-		sqlite_stmt = arg->stmt[5];
+		sqlite_stmt = STMT(arg, 5, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, ol_i_id);
 
-		ret = sqlite3_step(sqlite_stmt);
+		ret = tx_step(arg, sqlite_stmt);
 		if (ret != SQLITE_DONE) {
 			if (ret != SQLITE_ROW)
 				goto sqlerr;
@@ -305,57 +410,25 @@ int neword(int t_num, thread_arg *arg,
 		sqlite3_reset(sqlite_stmt);
 
 		price[ol_num_seq[ol_number - 1]] = i_price;
-		strncpy(iname[ol_num_seq[ol_number - 1]], i_name, 25);
 
 		/* EXEC SQL WHENEVER NOT FOUND GOTO sqlerr; */
 
-#ifdef DEBUG
-		printf("n %d\n", proceed);
-#endif
-		proceed = 7;
-
-		/*EXEC_SQL SELECT s_quantity, s_data, s_dist_01, s_dist_02,
-		                s_dist_03, s_dist_04, s_dist_05, s_dist_06,
-		                s_dist_07, s_dist_08, s_dist_09, s_dist_10
-			INTO :s_quantity, :s_data, :s_dist_01, :s_dist_02,
-		             :s_dist_03, :s_dist_04, :s_dist_05, :s_dist_06,
-		             :s_dist_07, :s_dist_08, :s_dist_09, :s_dist_10
-		        FROM stock
-		        WHERE s_i_id = :ol_i_id
-			AND s_w_id = :ol_supply_w_id
-			FOR UPDATE;*/
-
-		sqlite_stmt = arg->stmt[6];
-
-		sqlite3_bind_int64(sqlite_stmt, 1, ol_i_id);
-		sqlite3_bind_int64(sqlite_stmt, 2, ol_supply_w_id);
-
-		ret = sqlite3_step(sqlite_stmt);
-		if (ret != SQLITE_DONE) {
-			if (ret != SQLITE_ROW)
+		txphase_mark(arg, TXP_NO_STOCK);
+		/* a remote supply line was already run by its owner */
+		rs = remote_stock_line(arg, ol_num_seq[ol_number - 1]);
+		if (rs == NULL) {
+			rs = &local_stock;
+			rs->i_id = ol_i_id;
+			rs->w_id = ol_supply_w_id;
+			rs->d_id = d_id;
+			rs->qty = ol_quantity;
+			proceed = 7;
+			if (!neword_stock(t_num, arg, rs))
 				goto sqlerr;
-			num_cols = sqlite3_column_count(sqlite_stmt);
-			if (num_cols != 12)
-				goto sqlerr;
-
-			s_quantity = sqlite3_column_int64(sqlite_stmt, 0);
-			strcpy(s_data, sqlite3_column_text(sqlite_stmt, 1));
-			strcpy(s_dist_01, sqlite3_column_text(sqlite_stmt, 2));
-			strcpy(s_dist_02, sqlite3_column_text(sqlite_stmt, 3));
-			strcpy(s_dist_03, sqlite3_column_text(sqlite_stmt, 4));
-			strcpy(s_dist_04, sqlite3_column_text(sqlite_stmt, 5));
-			strcpy(s_dist_05, sqlite3_column_text(sqlite_stmt, 6));
-			strcpy(s_dist_06, sqlite3_column_text(sqlite_stmt, 7));
-			strcpy(s_dist_07, sqlite3_column_text(sqlite_stmt, 8));
-			strcpy(s_dist_08, sqlite3_column_text(sqlite_stmt, 9));
-			strcpy(s_dist_09, sqlite3_column_text(sqlite_stmt, 10));
-			strcpy(s_dist_10, sqlite3_column_text(sqlite_stmt, 11));
 		}
-
-		sqlite3_reset(sqlite_stmt);
-
-		pick_dist_info(ol_dist_info, d_id); /* pick correct
-							 * s_dist_xx */
+		s_quantity = rs->s_quantity;
+		strcpy(s_data, rs->s_data);
+		strncpy(ol_dist_info, rs->dist_info, 25);
 
 		stock[ol_num_seq[ol_number - 1]] = s_quantity;
 
@@ -365,31 +438,6 @@ int neword(int t_num, thread_arg *arg,
 		else
 			bg[ol_num_seq[ol_number - 1]] = 'G';
 
-		if (s_quantity > ol_quantity)
-			s_quantity = s_quantity - ol_quantity;
-		else
-			s_quantity = s_quantity - ol_quantity + 91;
-
-#ifdef DEBUG
-		printf("n %d\n", proceed);
-#endif
-
-		proceed = 8;
-		/*EXEC_SQL UPDATE stock SET s_quantity = :s_quantity
-		        WHERE s_i_id = :ol_i_id
-			AND s_w_id = :ol_supply_w_id;*/
-
-		sqlite_stmt = arg->stmt[7];
-
-		sqlite3_bind_int64(sqlite_stmt, 1, s_quantity);
-		sqlite3_bind_int64(sqlite_stmt, 2, ol_i_id);
-		sqlite3_bind_int64(sqlite_stmt, 3, ol_supply_w_id);
-
-		if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
-			goto sqlerr;
-
-		sqlite3_reset(sqlite_stmt);
-
 		ol_amount = ol_quantity * i_price * (1 + w_tax + d_tax) *
 			    (1 - c_discount);
 		amt[ol_num_seq[ol_number - 1]] = ol_amount;
@@ -399,6 +447,7 @@ int neword(int t_num, thread_arg *arg,
 		printf("n %d\n", proceed);
 #endif
 
+		txphase_mark(arg, TXP_NO_ORDERLINE);
 		proceed = 9;
 		/*EXEC_SQL INSERT INTO order_line (ol_o_id, ol_d_id, ol_w_id,
 						 ol_number, ol_i_id,
@@ -408,7 +457,7 @@ int neword(int t_num, thread_arg *arg,
 				:ol_supply_w_id, :ol_quantity, :ol_amount,
 				:ol_dist_info);*/
 
-		sqlite_stmt = arg->stmt[8];
+		sqlite_stmt = STMT(arg, 8, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, o_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, d_id);
@@ -421,7 +470,7 @@ int neword(int t_num, thread_arg *arg,
 		sqlite3_bind_text(sqlite_stmt, 9, ol_dist_info, -1,
 				  SQLITE_STATIC);
 
-		if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+		if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 			goto sqlerr;
 
 		sqlite3_reset(sqlite_stmt);
@@ -450,12 +499,11 @@ invaliditem:
 	return (1); /* OK? */
 
 sqlerr:
-	fprintf(stderr, "neword %d:%d\n", t_num, proceed);
-	printf("%s: error: %s\n", __func__, sqlite3_errmsg(arg->ctx));
+	tx_error(arg, TX_NEWORD, proceed);
 	//error(ctx[t_num],mysql_stmt);
 	/*EXEC SQL WHENEVER SQLERROR GOTO sqlerrerr;*/
 	/*EXEC_SQL ROLLBACK WORK;*/
-	sqlite3_exec(arg->ctx, "ROLLBACK;", NULL, NULL, NULL);
+	/* the caller rolls back */
 sqlerrerr:
 	return (0);
 }
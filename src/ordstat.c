@@ -12,6 +12,9 @@
 #include "spt_proc.h"
 #include "tpc.h"
 #include "main.h"
+#include "lockwait.h"
+#include "errstat.h"
+#include "txphase.h"
 
 /*
  * the order status transaction
@@ -54,6 +57,7 @@ int ordstat(int t_num, thread_arg *arg,
 	/*EXEC SQL WHENEVER NOT FOUND GOTO sqlerr;*/
 	/*EXEC SQL WHENEVER SQLERROR GOTO sqlerr;*/
 
+	txphase_mark(arg, TXP_OS_CUSTOMER);
 	if (byname) {
 		strcpy(c_last, c_last_arg);
 		proceed = 1;
@@ -64,13 +68,13 @@ int ordstat(int t_num, thread_arg *arg,
 			AND c_d_id = :c_d_id
 		        AND c_last = :c_last;*/
 
-		sqlite_stmt = arg->stmt[20];
+		sqlite_stmt = STMT(arg, 20, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, c_w_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
 		sqlite3_bind_text(sqlite_stmt, 3, c_last, -1, SQLITE_STATIC);
 
-		ret = sqlite3_step(sqlite_stmt);
+		ret = tx_step(arg, sqlite_stmt);
 		if (ret != SQLITE_DONE) {
 			if (ret != SQLITE_ROW)
 				goto sqlerr;
@@ -94,7 +98,7 @@ int ordstat(int t_num, thread_arg *arg,
 		proceed = 3;
 		EXEC_SQL OPEN c_byname_o;*/
 
-		sqlite_stmt = arg->stmt[21];
+		sqlite_stmt = STMT(arg, 21, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, c_w_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
@@ -104,7 +108,7 @@ int ordstat(int t_num, thread_arg *arg,
 			namecnt++; /* Locate midpoint customer; */
 
 		for (n = 0; n < namecnt / 2; n++) {
-			ret = sqlite3_step(sqlite_stmt);
+			ret = tx_step(arg, sqlite_stmt);
 			if (ret != SQLITE_DONE) {
 				if (ret != SQLITE_ROW)
 					goto sqlerr;
@@ -136,13 +140,13 @@ int ordstat(int t_num, thread_arg *arg,
 			AND c_d_id = :c_d_id
 			AND c_id = :c_id;*/
 
-		sqlite_stmt = arg->stmt[22];
+		sqlite_stmt = STMT(arg, 22, w_id);
 
 		sqlite3_bind_int64(sqlite_stmt, 1, c_w_id);
 		sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
-		sqlite3_bind_text(sqlite_stmt, 3, c_last, -1, SQLITE_STATIC);
+		sqlite3_bind_int64(sqlite_stmt, 3, c_id);
 
-		ret = sqlite3_step(sqlite_stmt);
+		ret = tx_step(arg, sqlite_stmt);
 		if (ret != SQLITE_DONE) {
 			if (ret != SQLITE_ROW)
 				goto sqlerr;
@@ -162,6 +166,7 @@ int ordstat(int t_num, thread_arg *arg,
 	/* find the most recent order for this customer */
 
 	proceed = 7;
+	txphase_mark(arg, TXP_OS_ORDER);
 	/*EXEC_SQL SELECT o_id, o_entry_d, COALESCE(o_carrier_id,0)
 		INTO :o_id, :o_entry_d, :o_carrier_id
 	        FROM orders
@@ -174,7 +179,7 @@ int ordstat(int t_num, thread_arg *arg,
 		  	    AND o_d_id = :c_d_id
 		    	    AND o_c_id = :c_id);*/
 
-	sqlite_stmt = arg->stmt[23];
+	sqlite_stmt = STMT(arg, 23, w_id);
 
 	sqlite3_bind_int64(sqlite_stmt, 1, c_w_id);
 	sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
@@ -183,7 +188,7 @@ int ordstat(int t_num, thread_arg *arg,
 	sqlite3_bind_int64(sqlite_stmt, 5, c_d_id);
 	sqlite3_bind_int64(sqlite_stmt, 6, c_id);
 
-	ret = sqlite3_step(sqlite_stmt);
+	ret = tx_step(arg, sqlite_stmt);
 	if (ret != SQLITE_DONE) {
 		if (ret != SQLITE_ROW)
 			goto sqlerr;
@@ -200,6 +205,7 @@ int ordstat(int t_num, thread_arg *arg,
 	sqlite3_reset(sqlite_stmt);
 
 	proceed = 8;
+	txphase_mark(arg, TXP_OS_LINES);
 	/*EXEC_SQL DECLARE c_items CURSOR FOR
 		SELECT ol_i_id, ol_supply_w_id, ol_quantity, ol_amount,
                        ol_delivery_d
@@ -208,14 +214,14 @@ int ordstat(int t_num, thread_arg *arg,
 		AND ol_d_id = :c_d_id
 		AND ol_o_id = :o_id;*/
 
-	sqlite_stmt = arg->stmt[24];
+	sqlite_stmt = STMT(arg, 24, w_id);
 
 	sqlite3_bind_int64(sqlite_stmt, 1, c_w_id);
 	sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
 	sqlite3_bind_int64(sqlite_stmt, 3, o_id);
 
 	for (;;) {
-		ret = sqlite3_step(sqlite_stmt);
+		ret = tx_step(arg, sqlite_stmt);
 
 		if (ret == SQLITE_DONE)
 			break;
@@ -253,13 +259,12 @@ done:
 	return (1);
 
 sqlerr:
-	fprintf(stderr, "ordstat %d:%d\n", t_num, proceed);
-	printf("%s: error: %s\n", __func__, sqlite3_errmsg(arg->ctx));
+	tx_error(arg, TX_ORDSTAT, proceed);
 
 	//error(ctx[t_num],mysql_stmt);
 	/*EXEC SQL WHENEVER SQLERROR GOTO sqlerrerr;*/
 	/*EXEC_SQL ROLLBACK WORK;*/
-	sqlite3_exec(arg->ctx, "ROLLBACK;", NULL, NULL, NULL);
+	/* the caller rolls back */
 sqlerrerr:
 	return (0);
 }
@@ -6,6 +6,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 
 #include <sqlite3.h>
@@ -13,34 +14,21 @@
 #include "spt_proc.h"
 #include "tpc.h"
 #include "main.h"
+#include "lockwait.h"
+#include "errstat.h"
+#include "txphase.h"
+#include "remote.h"
+#include "trans_if.h"
 
 /*
- * the payment transaction
+ * find and charge the customer of a payment. in shared-nothing mode the
+ * owner of a remote customer's warehouse runs it for the paying thread.
  */
-int payment(int t_num, thread_arg *arg,
-	    int w_id_arg, /* warehouse id */
-	    int d_id_arg, /* district id */
-	    int byname, /* select by c_id or c_last? */
-	    int c_w_id_arg, int c_d_id_arg, int c_id_arg, /* customer id */
-	    char c_last_arg[], /* customer last name */
-	    float h_amount_arg /* payment amount */
-)
+int payment_customer(int t_num, thread_arg *arg, remote_cust_t *pc)
 {
 	int ret;
-	int w_id = w_id_arg;
-	int d_id = d_id_arg;
-	int c_id = c_id_arg;
-	char w_name[11];
-	char w_street_1[21];
-	char w_street_2[21];
-	char w_city[21];
-	char w_state[3];
-	char w_zip[10];
-	int c_d_id = c_d_id_arg;
-	int c_w_id = c_w_id_arg;
 	char c_first[17];
 	char c_middle[3];
-	char c_last[17];
 	char c_street_1[21];
 	char c_street_2[21];
 	char c_city[21];
@@ -54,122 +42,15 @@ int payment(int t_num, thread_arg *arg,
 	float c_balance;
 	char c_data[502];
 	char c_new_data[502];
-	float h_amount = h_amount_arg;
-	char h_data[26];
-	char d_name[11];
-	char d_street_1[21];
-	char d_street_2[21];
-	char d_city[21];
-	char d_state[3];
-	char d_zip[10];
 	int namecnt;
-	char datetime[81];
 
 	int n;
 	int proceed = 0;
-	int bytes;
 
 	sqlite3_stmt *sqlite_stmt;
 	int num_cols;
 
-	/* EXEC SQL WHENEVER NOT FOUND GOTO sqlerr; */
-	/* EXEC SQL WHENEVER SQLERROR GOTO sqlerr; */
-
-	gettimestamp(datetime, STRFTIME_FORMAT, TIMESTAMP_LEN);
-
-	proceed = 1;
-	/*EXEC_SQL UPDATE warehouse SET w_ytd = w_ytd + :h_amount
-	  WHERE w_id =:w_id;*/
-
-	sqlite_stmt = arg->stmt[9];
-
-	sqlite3_bind_double(sqlite_stmt, 1, h_amount);
-	sqlite3_bind_int64(sqlite_stmt, 2, w_id);
-
-	if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
-		goto sqlerr;
-
-	sqlite3_reset(sqlite_stmt);
-
-	proceed = 2;
-	/*EXEC_SQL SELECT w_street_1, w_street_2, w_city, w_state, w_zip,
-	                w_name
-	                INTO :w_street_1, :w_street_2, :w_city, :w_state,
-				:w_zip, :w_name
-	                FROM warehouse
-	                WHERE w_id = :w_id;*/
-
-	sqlite_stmt = arg->stmt[10];
-
-	sqlite3_bind_int64(sqlite_stmt, 1, w_id);
-
-	ret = sqlite3_step(sqlite_stmt);
-	if (ret != SQLITE_DONE) {
-		if (ret != SQLITE_ROW)
-			goto sqlerr;
-		num_cols = sqlite3_column_count(sqlite_stmt);
-		if (num_cols != 6)
-			goto sqlerr;
-
-		strcpy(w_street_1, sqlite3_column_text(sqlite_stmt, 0));
-		strcpy(w_street_2, sqlite3_column_text(sqlite_stmt, 1));
-		strcpy(w_city, sqlite3_column_text(sqlite_stmt, 2));
-		strcpy(w_state, sqlite3_column_text(sqlite_stmt, 3));
-		strcpy(w_zip, sqlite3_column_text(sqlite_stmt, 4));
-		strcpy(w_name, sqlite3_column_text(sqlite_stmt, 5));
-	}
-
-	sqlite3_reset(sqlite_stmt);
-	proceed = 3;
-	/*EXEC_SQL UPDATE district SET d_ytd = d_ytd + :h_amount
-			WHERE d_w_id = :w_id
-			AND d_id = :d_id;*/
-
-	sqlite_stmt = arg->stmt[11];
-
-	sqlite3_bind_double(sqlite_stmt, 1, h_amount);
-	sqlite3_bind_int64(sqlite_stmt, 2, w_id);
-	sqlite3_bind_int64(sqlite_stmt, 3, d_id);
-
-	if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
-		goto sqlerr;
-
-	sqlite3_reset(sqlite_stmt);
-	proceed = 4;
-	/*EXEC_SQL SELECT d_street_1, d_street_2, d_city, d_state, d_zip,
-	                d_name
-	                INTO :d_street_1, :d_street_2, :d_city, :d_state,
-				:d_zip, :d_name
-	                FROM district
-	                WHERE d_w_id = :w_id
-			AND d_id = :d_id;*/
-
-	sqlite_stmt = arg->stmt[12];
-
-	sqlite3_bind_int64(sqlite_stmt, 1, w_id);
-	sqlite3_bind_int64(sqlite_stmt, 2, d_id);
-
-	ret = sqlite3_step(sqlite_stmt);
-	if (ret != SQLITE_DONE) {
-		if (ret != SQLITE_ROW)
-			goto sqlerr;
-		num_cols = sqlite3_column_count(sqlite_stmt);
-		if (num_cols != 6)
-			goto sqlerr;
-
-		strcpy(d_street_1, sqlite3_column_text(sqlite_stmt, 0));
-		strcpy(d_street_2, sqlite3_column_text(sqlite_stmt, 1));
-		strcpy(d_city, sqlite3_column_text(sqlite_stmt, 2));
-		strcpy(d_state, sqlite3_column_text(sqlite_stmt, 3));
-		strcpy(d_zip, sqlite3_column_text(sqlite_stmt, 4));
-		strcpy(d_name, sqlite3_column_text(sqlite_stmt, 5));
-	}
-
-	sqlite3_reset(sqlite_stmt);
-
-	if (byname) {
-		strcpy(c_last, c_last_arg);
-
+	if (pc->byname) {
 		proceed = 5;
 		/*EXEC_SQL SELECT count(c_id)
 			INTO :namecnt
@@ -178,13 +59,13 @@ int payment(int t_num, thread_arg *arg,
 			AND c_d_id = :c_d_id
 		        AND c_last = :c_last;*/
 
-		sqlite_stmt = arg->stmt[13];
+		sqlite_stmt = STMT(arg, 13, pc->c_w_id);
 
-		sqlite3_bind_int64(sqlite_stmt, 1, c_w_id);
-		sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
-		sqlite3_bind_text(sqlite_stmt, 3, c_last, -1, SQLITE_STATIC);
+		sqlite3_bind_int64(sqlite_stmt, 1, pc->c_w_id);
+		sqlite3_bind_int64(sqlite_stmt, 2, pc->c_d_id);
+		sqlite3_bind_text(sqlite_stmt, 3, pc->c_last, -1, SQLITE_STATIC);
 
-		ret = sqlite3_step(sqlite_stmt);
+		ret = tx_step(arg, sqlite_stmt);
 		if (ret != SQLITE_DONE) {
 			if (ret != SQLITE_ROW)
 				goto sqlerr;
@@ -207,17 +88,17 @@ int payment(int t_num, thread_arg *arg,
 
 			EXEC_SQL OPEN c_byname_p;*/
 
-		sqlite_stmt = arg->stmt[14];
+		sqlite_stmt = STMT(arg, 14, pc->c_w_id);
 
-		sqlite3_bind_int64(sqlite_stmt, 1, c_w_id);
-		sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
-		sqlite3_bind_text(sqlite_stmt, 3, c_last, -1, SQLITE_STATIC);
+		sqlite3_bind_int64(sqlite_stmt, 1, pc->c_w_id);
+		sqlite3_bind_int64(sqlite_stmt, 2, pc->c_d_id);
+		sqlite3_bind_text(sqlite_stmt, 3, pc->c_last, -1, SQLITE_STATIC);
 
 		if (namecnt % 2)
 			namecnt++;
 
 		for (n = 0; n < namecnt / 2; n++) {
-			ret = sqlite3_step(sqlite_stmt);
+			ret = tx_step(arg, sqlite_stmt);
 			if (ret != SQLITE_DONE) {
 				if (ret != SQLITE_ROW)
 					goto sqlerr;
@@ -225,7 +106,7 @@ int payment(int t_num, thread_arg *arg,
 				if (num_cols != 1)
 					goto sqlerr;
 
-				c_id = sqlite3_column_int64(sqlite_stmt, 0);
+				pc->c_id = sqlite3_column_int64(sqlite_stmt, 0);
 			}
 		}
 
@@ -247,13 +128,13 @@ int payment(int t_num, thread_arg *arg,
 		AND c_id = :c_id
 		FOR UPDATE;*/
 
-	sqlite_stmt = arg->stmt[15];
+	sqlite_stmt = STMT(arg, 15, pc->c_w_id);
 
-	sqlite3_bind_int64(sqlite_stmt, 1, c_w_id);
-	sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
-	sqlite3_bind_int64(sqlite_stmt, 3, c_id);
+	sqlite3_bind_int64(sqlite_stmt, 1, pc->c_w_id);
+	sqlite3_bind_int64(sqlite_stmt, 2, pc->c_d_id);
+	sqlite3_bind_int64(sqlite_stmt, 3, pc->c_id);
 
-	ret = sqlite3_step(sqlite_stmt);
+	ret = tx_step(arg, sqlite_stmt);
 	if (ret != SQLITE_DONE) {
 		if (ret != SQLITE_ROW)
 			goto sqlerr;
@@ -263,7 +144,7 @@ int payment(int t_num, thread_arg *arg,
 
 		strcpy(c_first, sqlite3_column_text(sqlite_stmt, 0));
 		strcpy(c_middle, sqlite3_column_text(sqlite_stmt, 1));
-		strcpy(c_last, sqlite3_column_text(sqlite_stmt, 2));
+		strcpy(pc->c_last, sqlite3_column_text(sqlite_stmt, 2));
 		strcpy(c_street_1, sqlite3_column_text(sqlite_stmt, 3));
 		strcpy(c_street_2, sqlite3_column_text(sqlite_stmt, 4));
 		strcpy(c_city, sqlite3_column_text(sqlite_stmt, 5));
@@ -279,7 +160,7 @@ int payment(int t_num, thread_arg *arg,
 
 	sqlite3_reset(sqlite_stmt);
 
-	c_balance = c_balance - h_amount;
+	c_balance = c_balance - pc->h_amount;
 	c_credit[2] = '\0';
 	if (strstr(c_credit, "BC")) {
 		proceed = 7;
@@ -290,13 +171,13 @@ int payment(int t_num, thread_arg *arg,
 			AND c_d_id = :c_d_id
 			AND c_id = :c_id; */
 
-		sqlite_stmt = arg->stmt[16];
+		sqlite_stmt = STMT(arg, 16, pc->c_w_id);
 
-		sqlite3_bind_int64(sqlite_stmt, 1, c_w_id);
-		sqlite3_bind_int64(sqlite_stmt, 2, c_d_id);
-		sqlite3_bind_int64(sqlite_stmt, 3, c_id);
+		sqlite3_bind_int64(sqlite_stmt, 1, pc->c_w_id);
+		sqlite3_bind_int64(sqlite_stmt, 2, pc->c_d_id);
+		sqlite3_bind_int64(sqlite_stmt, 3, pc->c_id);
 
-		ret = sqlite3_step(sqlite_stmt);
+		ret = tx_step(arg, sqlite_stmt);
 		if (ret != SQLITE_DONE) {
 			if (ret != SQLITE_ROW)
 				goto sqlerr;
@@ -310,7 +191,7 @@ int payment(int t_num, thread_arg *arg,
 		sqlite3_reset(sqlite_stmt);
 
 		sprintf(c_new_data, "| %4d %2d %4d %2d %4d $%7.2f %12c %24c",
-			c_id, c_d_id, c_w_id, d_id, w_id, h_amount, datetime,
+			pc->c_id, pc->c_d_id, pc->c_w_id, pc->d_id, pc->w_id, pc->h_amount, pc->datetime,
 			c_data);
 
 		strncat(c_new_data, c_data, 500 - strlen(c_new_data));
@@ -324,15 +205,15 @@ int payment(int t_num, thread_arg *arg,
 			AND c_d_id = :c_d_id
 			AND c_id = :c_id;*/
 
-		sqlite_stmt = arg->stmt[17];
+		sqlite_stmt = STMT(arg, 17, pc->c_w_id);
 
 		sqlite3_bind_double(sqlite_stmt, 1, c_balance);
 		sqlite3_bind_text(sqlite_stmt, 2, c_data, -1, SQLITE_STATIC);
-		sqlite3_bind_int64(sqlite_stmt, 3, c_w_id);
-		sqlite3_bind_int64(sqlite_stmt, 4, c_d_id);
-		sqlite3_bind_int64(sqlite_stmt, 5, c_id);
+		sqlite3_bind_int64(sqlite_stmt, 3, pc->c_w_id);
+		sqlite3_bind_int64(sqlite_stmt, 4, pc->c_d_id);
+		sqlite3_bind_int64(sqlite_stmt, 5, pc->c_id);
 
-		if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+		if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 			goto sqlerr;
 
 		sqlite3_reset(sqlite_stmt);
@@ -345,19 +226,184 @@ int payment(int t_num, thread_arg *arg,
 			AND c_d_id = :c_d_id
 			AND c_id = :c_id;*/
 
-		sqlite_stmt = arg->stmt[18];
+		sqlite_stmt = STMT(arg, 18, pc->c_w_id);
 
 		sqlite3_bind_double(sqlite_stmt, 1, c_balance);
-		sqlite3_bind_int64(sqlite_stmt, 2, c_w_id);
-		sqlite3_bind_int64(sqlite_stmt, 3, c_d_id);
-		sqlite3_bind_int64(sqlite_stmt, 4, c_id);
+		sqlite3_bind_int64(sqlite_stmt, 2, pc->c_w_id);
+		sqlite3_bind_int64(sqlite_stmt, 3, pc->c_d_id);
+		sqlite3_bind_int64(sqlite_stmt, 4, pc->c_id);
 
-		if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+		if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 			goto sqlerr;
 
 		sqlite3_reset(sqlite_stmt);
 	}
 
+	return (1);
+
+sqlerr:
+	tx_error(arg, TX_PAYMENT, proceed);
+	sqlite3_reset(sqlite_stmt);
+	return (0);
+}
+
+/*
+ * the payment transaction
+ */
+int payment(int t_num, thread_arg *arg,
+	    int w_id_arg, /* warehouse id */
+	    int d_id_arg, /* district id */
+	    int byname, /* select by c_id or c_last? */
+	    int c_w_id_arg, int c_d_id_arg, int c_id_arg, /* customer id */
+	    char c_last_arg[], /* customer last name */
+	    float h_amount_arg /* payment amount */
+)
+{
+	int ret;
+	int w_id = w_id_arg;
+	int d_id = d_id_arg;
+	int c_id = c_id_arg;
+	char w_name[11];
+	char w_street_1[21];
+	char w_street_2[21];
+	char w_city[21];
+	char w_state[3];
+	char w_zip[10];
+	int c_d_id = c_d_id_arg;
+	int c_w_id = c_w_id_arg;
+	float h_amount = h_amount_arg;
+	char h_data[26];
+	char d_name[11];
+	char d_street_1[21];
+	char d_street_2[21];
+	char d_city[21];
+	char d_state[3];
+	char d_zip[10];
+	char datetime[81];
+	remote_cust_t local_cust, *pc;
+
+	int proceed = 0;
+	int bytes;
+
+	sqlite3_stmt *sqlite_stmt;
+	int num_cols;
+
+	/* EXEC SQL WHENEVER NOT FOUND GOTO sqlerr; */
+	/* EXEC SQL WHENEVER SQLERROR GOTO sqlerr; */
+
+	gettimestamp(datetime, STRFTIME_FORMAT, TIMESTAMP_LEN);
+
+	proceed = 1;
+	txphase_mark(arg, TXP_PY_WAREHOUSE);
+	/*EXEC_SQL UPDATE warehouse SET w_ytd = w_ytd + :h_amount
+	  WHERE w_id =:w_id;*/
+
+	sqlite_stmt = STMT(arg, 9, w_id);
+
+	sqlite3_bind_double(sqlite_stmt, 1, h_amount);
+	sqlite3_bind_int64(sqlite_stmt, 2, w_id);
+
+	if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
+		goto sqlerr;
+
+	sqlite3_reset(sqlite_stmt);
+
+	proceed = 2;
+	/*EXEC_SQL SELECT w_street_1, w_street_2, w_city, w_state, w_zip,
+	                w_name
+	                INTO :w_street_1, :w_street_2, :w_city, :w_state,
+				:w_zip, :w_name
+	                FROM warehouse
+	                WHERE w_id = :w_id;*/
+
+	sqlite_stmt = STMT(arg, 10, w_id);
+
+	sqlite3_bind_int64(sqlite_stmt, 1, w_id);
+
+	ret = tx_step(arg, sqlite_stmt);
+	if (ret != SQLITE_DONE) {
+		if (ret != SQLITE_ROW)
+			goto sqlerr;
+		num_cols = sqlite3_column_count(sqlite_stmt);
+		if (num_cols != 6)
+			goto sqlerr;
+
+		strcpy(w_street_1, sqlite3_column_text(sqlite_stmt, 0));
+		strcpy(w_street_2, sqlite3_column_text(sqlite_stmt, 1));
+		strcpy(w_city, sqlite3_column_text(sqlite_stmt, 2));
+		strcpy(w_state, sqlite3_column_text(sqlite_stmt, 3));
+		strcpy(w_zip, sqlite3_column_text(sqlite_stmt, 4));
+		strcpy(w_name, sqlite3_column_text(sqlite_stmt, 5));
+	}
+
+	sqlite3_reset(sqlite_stmt);
+	proceed = 3;
+	txphase_mark(arg, TXP_PY_DISTRICT);
+	/*EXEC_SQL UPDATE district SET d_ytd = d_ytd + :h_amount
+			WHERE d_w_id = :w_id
+			AND d_id = :d_id;*/
+
+	sqlite_stmt = STMT(arg, 11, w_id);
+
+	sqlite3_bind_double(sqlite_stmt, 1, h_amount);
+	sqlite3_bind_int64(sqlite_stmt, 2, w_id);
+	sqlite3_bind_int64(sqlite_stmt, 3, d_id);
+
+	if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
+		goto sqlerr;
+
+	sqlite3_reset(sqlite_stmt);
+	proceed = 4;
+	/*EXEC_SQL SELECT d_street_1, d_street_2, d_city, d_state, d_zip,
+	                d_name
+	                INTO :d_street_1, :d_street_2, :d_city, :d_state,
+				:d_zip, :d_name
+	                FROM district
+	                WHERE d_w_id = :w_id
+			AND d_id = :d_id;*/
+
+	sqlite_stmt = STMT(arg, 12, w_id);
+
+	sqlite3_bind_int64(sqlite_stmt, 1, w_id);
+	sqlite3_bind_int64(sqlite_stmt, 2, d_id);
+
+	ret = tx_step(arg, sqlite_stmt);
+	if (ret != SQLITE_DONE) {
+		if (ret != SQLITE_ROW)
+			goto sqlerr;
+		num_cols = sqlite3_column_count(sqlite_stmt);
+		if (num_cols != 6)
+			goto sqlerr;
+
+		strcpy(d_street_1, sqlite3_column_text(sqlite_stmt, 0));
+		strcpy(d_street_2, sqlite3_column_text(sqlite_stmt, 1));
+		strcpy(d_city, sqlite3_column_text(sqlite_stmt, 2));
+		strcpy(d_state, sqlite3_column_text(sqlite_stmt, 3));
+		strcpy(d_zip, sqlite3_column_text(sqlite_stmt, 4));
+		strcpy(d_name, sqlite3_column_text(sqlite_stmt, 5));
+	}
+
+	sqlite3_reset(sqlite_stmt);
+
+	/* a remote customer was already charged by its owner */
+	txphase_mark(arg, TXP_PY_CUSTOMER);
+	pc = remote_customer(arg);
+	if (pc == NULL) {
+		pc = &local_cust;
+		pc->byname = byname;
+		pc->c_w_id = c_w_id;
+		pc->c_d_id = c_d_id;
+		pc->c_id = c_id;
+		strcpy(pc->c_last, c_last_arg);
+		pc->h_amount = h_amount;
+		pc->w_id = w_id;
+		pc->d_id = d_id;
+		strcpy(pc->datetime, datetime);
+		if (!payment_customer(t_num, arg, pc))
+			goto sqlerr;
+	}
+	c_id = pc->c_id;
+
 	strncpy(h_data, w_name, 10);
 	h_data[10] = '\0';
 	strncat(h_data, d_name, 10);
@@ -368,6 +414,7 @@ int payment(int t_num, thread_arg *arg,
 	h_data[24] = '\0';
 
 	proceed = 10;
+	txphase_mark(arg, TXP_PY_HISTORY);
 	/*EXEC_SQL INSERT INTO history(h_c_d_id, h_c_w_id, h_c_id, h_d_id,
 			                   h_w_id, h_date, h_amount, h_data)
 	                VALUES(:c_d_id, :c_w_id, :c_id, :d_id,
@@ -375,7 +422,7 @@ int payment(int t_num, thread_arg *arg,
 			       :datetime,
 			       :h_amount, :h_data);*/
 
-	sqlite_stmt = arg->stmt[19];
+	sqlite_stmt = STMT(arg, 19, w_id);
 
 	sqlite3_bind_int64(sqlite_stmt, 1, c_d_id);
 	sqlite3_bind_int64(sqlite_stmt, 2, c_w_id);
@@ -386,7 +433,7 @@ int payment(int t_num, thread_arg *arg,
 	sqlite3_bind_double(sqlite_stmt, 7, h_amount);
 	sqlite3_bind_text(sqlite_stmt, 8, h_data, -1, SQLITE_STATIC);
 
-	if (sqlite3_step(sqlite_stmt) != SQLITE_DONE)
+	if (tx_step(arg, sqlite_stmt) != SQLITE_DONE)
 		goto sqlerr;
 
 	sqlite3_reset(sqlite_stmt);
@@ -396,13 +443,11 @@ int payment(int t_num, thread_arg *arg,
 	return (1);
 
 sqlerr:
-	fprintf(stderr, "payment %d:%d\n", t_num, proceed);
-	printf("%s: error: %s\n", __func__, sqlite3_errmsg(arg->ctx));
-	exit(-1);
+	tx_error(arg, TX_PAYMENT, proceed);
 	//error(ctx[t_num],mysql_stmt);
 	/*EXEC SQL WHENEVER SQLERROR GOTO sqlerrerr;*/
 	/*EXEC_SQL ROLLBACK WORK;*/
-	sqlite3_exec(arg->ctx, "ROLLBACK;", NULL, NULL, NULL);
+	/* the caller rolls back */
 sqlerrerr:
 	return (0);
 }
@@ -0,0 +1,305 @@
+/*
+ * profile.c
+ * named PRAGMA profiles applied to every connection
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "profile.h"
+
+#define MAX_PROFILES 32
+#define MAX_SETTINGS 32
+#define NAME_LEN 32
+#define VALUE_LEN 64
+
+typedef struct {
+	char name[NAME_LEN + 1]; /* room for the "+" of overrides */
+	int n;
+	char key[MAX_SETTINGS][NAME_LEN];
+	char val[MAX_SETTINGS][VALUE_LEN];
+} profile_t;
+
+static const char *builtin[] = {
+	"default", "journal_mode=WAL",
+	"durable", "journal_mode=WAL,synchronous=FULL,wal_autocheckpoint=1000",
+	"fast-nosync", "journal_mode=WAL,synchronous=OFF,temp_store=MEMORY,"
+		       "cache_size=-65536,cache_spill=0",
+	"mmap-heavy", "journal_mode=WAL,synchronous=NORMAL,"
+		      "mmap_size=1073741824,cache_size=-8192",
+	NULL
+};
+
+/* set on the connection, not per schema */
+static const char *conn_pragmas[] = {
+	"busy_timeout", "temp_store", "wal_autocheckpoint", "cache_spill",
+	"threads", "foreign_keys", "query_only", "automatic_index",
+	"recursive_triggers", "analysis_limit", "soft_heap_limit",
+	"hard_heap_limit", NULL
+};
+
+/* left alone on read-only connections */
+static const char *write_pragmas[] = {
+	"journal_mode", "locking_mode", "journal_size_limit", NULL
+};
+
+static profile_t profiles[MAX_PROFILES];
+static int num_profiles;
+static profile_t active;
+
+static int in_list(const char **list, const char *s)
+{
+	for (; *list; list++) {
+		if (strcasecmp(*list, s) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/* pragma names and values end up in SQL: words, numbers and '-' only */
+static int valid_word(const char *s, int len)
+{
+	if (*s == '\0' || (int)strlen(s) >= len)
+		return 0;
+	for (; *s; s++) {
+		if (!isalnum((unsigned char)*s) && *s != '_' && *s != '-')
+			return 0;
+	}
+	return 1;
+}
+
+static char *trim(char *s)
+{
+	char *e;
+
+	while (isspace((unsigned char)*s))
+		s++;
+	e = s + strlen(s);
+	while (e > s && isspace((unsigned char)e[-1]))
+		*--e = '\0';
+	return s;
+}
+
+/* set key to val in p, in place when it is already there */
+static int profile_set(profile_t *p, char *key, char *val)
+{
+	int i;
+
+	key = trim(key);
+	val = trim(val);
+	if (!valid_word(key, NAME_LEN) || !valid_word(val, VALUE_LEN))
+		return 1;
+	for (i = 0; i < p->n; i++) {
+		if (strcasecmp(p->key[i], key) == 0)
+			break;
+	}
+	if (i == p->n) {
+		if (p->n == MAX_SETTINGS)
+			return 1;
+		p->n++;
+	}
+	strcpy(p->key[i], key);
+	strcpy(p->val[i], val);
+	return 0;
+}
+
+/* key=value[,key=value...] into p */
+static int profile_set_list(profile_t *p, const char *list)
+{
+	char buf[1024], *item, *save, *eq;
+
+	if (strlen(list) >= sizeof(buf))
+		return 1;
+	strcpy(buf, list);
+	for (item = strtok_r(buf, ",", &save); item;
+	     item = strtok_r(NULL, ",", &save)) {
+		eq = strchr(item, '=');
+		if (eq == NULL)
+			return 1;
+		*eq = '\0';
+		if (profile_set(p, item, eq + 1))
+			return 1;
+	}
+	return 0;
+}
+
+static profile_t *profile_find(const char *name)
+{
+	int i;
+
+	for (i = 0; i < num_profiles; i++) {
+		if (strcmp(profiles[i].name, name) == 0)
+			return &profiles[i];
+	}
+	return NULL;
+}
+
+/* an empty profile called name, replacing an earlier one */
+static profile_t *profile_new(const char *name)
+{
+	profile_t *p = profile_find(name);
+
+	if (p == NULL) {
+		if (num_profiles == MAX_PROFILES)
+			return NULL;
+		p = &profiles[num_profiles++];
+	}
+	memset(p, 0, sizeof(*p));
+	strcpy(p->name, name);
+	return p;
+}
+
+static void load_builtin(void)
+{
+	int i;
+
+	if (num_profiles > 0)
+		return;
+	for (i = 0; builtin[i]; i += 2)
+		profile_set_list(profile_new(builtin[i]), builtin[i + 1]);
+}
+
+/*
+ * without -p, "default" as it stands after -F, which may replace it.
+ * main() describes the profile before any connection is opened, so the
+ * workers find it resolved.
+ */
+static void resolve_active(void)
+{
+	load_builtin();
+	if (active.name[0] == '\0')
+		active = *profile_find("default");
+}
+
+/* read the profiles of a file, returns 1 on error */
+int profile_load(const char *path)
+{
+	FILE *fp;
+	char line[256], *s, *eq;
+	profile_t *p = NULL;
+	int lineno = 0;
+
+	load_builtin();
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		perror(path);
+		return 1;
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		s = trim(line);
+		if (*s == '\0' || *s == '#' || *s == ';')
+			continue;
+		if (*s == '[') {
+			eq = strchr(s, ']');
+			if (eq == NULL)
+				goto bad;
+			*eq = '\0';
+			s = trim(s + 1);
+			if (!valid_word(s, NAME_LEN) ||
+			    (p = profile_new(s)) == NULL)
+				goto bad;
+			continue;
+		}
+		eq = strchr(s, '=');
+		if (p == NULL || eq == NULL)
+			goto bad;
+		*eq = '\0';
+		if (profile_set(p, s, eq + 1))
+			goto bad;
+	}
+	fclose(fp);
+	return 0;
+
+bad:
+	fprintf(stderr, "%s:%d: bad profile line\n", path, lineno);
+	fclose(fp);
+	return 1;
+}
+
+/* name[,key=value...]; overrides go on top of the named profile */
+int profile_select(const char *spec)
+{
+	char name[NAME_LEN];
+	const char *comma = strchr(spec, ',');
+	size_t len = comma ? (size_t)(comma - spec) : strlen(spec);
+	profile_t *p;
+
+	load_builtin();
+	if (len >= sizeof(name))
+		return 1;
+	memcpy(name, spec, len);
+	name[len] = '\0';
+	p = profile_find(name);
+	if (p == NULL)
+		return 1;
+	active = *p;
+	if (comma && profile_set_list(&active, comma + 1))
+		return 1;
+	if (comma)
+		strcat(active.name, "+");
+	return 0;
+}
+
+const char *profile_describe(void)
+{
+	static char buf[MAX_SETTINGS * (NAME_LEN + VALUE_LEN) + NAME_LEN];
+	int i, n;
+
+	resolve_active();
+	n = snprintf(buf, sizeof(buf), "%s (", active.name);
+	for (i = 0; i < active.n; i++)
+		n += snprintf(buf + n, sizeof(buf) - n, "%s%s=%s",
+			      i ? " " : "", active.key[i], active.val[i]);
+	snprintf(buf + n, sizeof(buf) - n, ")");
+	return buf;
+}
+
+static int exec_pragma(sqlite3 *db, const char *schema, const char *key,
+		       const char *val)
+{
+	char *sql;
+	int rc;
+
+	if (schema)
+		sql = sqlite3_mprintf("PRAGMA \"%w\".%s = %s;", schema, key,
+				      val);
+	else
+		sql = sqlite3_mprintf("PRAGMA %s = %s;", key, val);
+	rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+	if (rc != SQLITE_OK)
+		fprintf(stderr, "%s failed: %s\n", sql, sqlite3_errmsg(db));
+	sqlite3_free(sql);
+	return rc != SQLITE_OK;
+}
+
+/*
+ * apply the selected profile to db, after the shards are attached.
+ * read-only connections skip the settings that need to write.
+ */
+int profile_apply(sqlite3 *db, int readonly)
+{
+	const char *schema;
+	int i, k;
+
+	resolve_active();
+	for (i = 0; i < active.n; i++) {
+		if (readonly && in_list(write_pragmas, active.key[i]))
+			continue;
+		if (in_list(conn_pragmas, active.key[i])) {
+			if (exec_pragma(db, NULL, active.key[i], active.val[i]))
+				return 1;
+			continue;
+		}
+		for (k = 0; (schema = sqlite3_db_name(db, k)) != NULL; k++) {
+			if (strcmp(schema, "temp") == 0)
+				continue;
+			if (exec_pragma(db, schema, active.key[i],
+					active.val[i]))
+				return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,31 @@
+/*
+ * profile.h
+ * named PRAGMA profiles applied to every connection
+ *
+ * A profile is a list of pragma = value settings. There are built-in
+ * ones and more can be read from a file (-F) of sections like
+ *
+ *	# comment
+ *	[my-profile]
+ *	synchronous = NORMAL
+ *	cache_size = -65536
+ *
+ * where a section named like a built-in one replaces it. -p picks one
+ * by name, optionally followed by overrides: -p fast-nosync,cache_size=-8192.
+ * Without -p both tpcc_load and tpcc_start use "default".
+ * The settings are applied in order, to main and to every attached
+ * shard for the per-schema pragmas. busy_timeout replaces the busy
+ * handler of -B.
+ */
+
+#ifndef _TPCC_PROFILE_H_
+#define _TPCC_PROFILE_H_
+
+#include <sqlite3.h>
+
+int profile_load(const char *path);
+int profile_select(const char *spec);
+const char *profile_describe(void);
+int profile_apply(sqlite3 *db, int readonly);
+
+#endif
@@ -0,0 +1,296 @@
+/*
+ * remote.c
+ * shared-nothing mode: work on warehouses owned by other threads
+ *
+ * A thread ships the remote parts of a tx before each attempt of its
+ * own transaction and waits for them, serving the requests shipped to
+ * it meanwhile. The owner runs each batch of requests in a transaction
+ * of its own and commits it before replying. A part that failed is
+ * shipped again with the next attempt; one that committed is not.
+ *
+ * The parts are not atomic: a remote part stays committed when the
+ * local part then fails for good (MAX_RETRY attempts, or the run
+ * stops), leaving e.g. a stock update without its order line. Such txs
+ * are counted as orphans and reported. Requests are only served
+ * outside of the owner's own transaction, so two threads shipping to
+ * each other cannot deadlock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+
+#include "remote.h"
+#include "trans_if.h"
+#include "spt_proc.h"
+#include "errstat.h"
+
+/* more than the requests a sender can have in flight to one owner */
+#define RING_SIZE 16
+
+/* single producer (the sender), single consumer (the owner) */
+typedef struct {
+	unsigned head __attribute__((aligned(CACHE_LINE_SIZE))); /* owner */
+	unsigned tail __attribute__((aligned(CACHE_LINE_SIZE))); /* sender */
+	remote_req_t *slot[RING_SIZE] __attribute__((aligned(CACHE_LINE_SIZE)));
+} ring_t;
+
+int shared_nothing = 0;
+
+static int num_threads;
+static ring_t *rings; /* [owner][sender] */
+static remote_ctx_t *ctxs;
+static int running; /* threads still running transactions */
+static uint64_t orphans; /* remote parts left without their local part */
+
+int remote_init(int nthreads)
+{
+	num_threads = nthreads;
+	running = nthreads;
+	if (posix_memalign((void **)&rings, CACHE_LINE_SIZE,
+			   sizeof(ring_t) * nthreads * nthreads))
+		return 1;
+	memset(rings, 0, sizeof(ring_t) * nthreads * nthreads);
+	if (posix_memalign((void **)&ctxs, CACHE_LINE_SIZE,
+			   sizeof(remote_ctx_t) * nthreads))
+		return 1;
+	memset(ctxs, 0, sizeof(remote_ctx_t) * nthreads);
+	return 0;
+}
+
+remote_ctx_t *remote_get(int t_num)
+{
+	return &ctxs[t_num];
+}
+
+void remote_done(void)
+{
+	free(rings);
+	free(ctxs);
+	rings = NULL;
+	ctxs = NULL;
+}
+
+static ring_t *ring_of(int owner, int sender)
+{
+	return &rings[owner * num_threads + sender];
+}
+
+static int ring_push(ring_t *r, remote_req_t *req)
+{
+	unsigned t = r->tail;
+
+	if (t - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == RING_SIZE)
+		return 1;
+	r->slot[t % RING_SIZE] = req;
+	__atomic_store_n(&r->tail, t + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static remote_req_t *ring_pop(ring_t *r)
+{
+	unsigned h = r->head;
+	remote_req_t *req;
+
+	if (h == __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE))
+		return NULL;
+	req = r->slot[h % RING_SIZE];
+	__atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+	return req;
+}
+
+/* the tx a request is part of */
+static const int req_tx[] = {
+	[REMOTE_STOCK] = TX_NEWORD,
+	[REMOTE_CUSTOMER] = TX_PAYMENT,
+};
+
+static int run_req(int t_num, thread_arg *arg, remote_req_t *req)
+{
+	switch (req->op) {
+	case REMOTE_STOCK:
+		return neword_stock(t_num, arg, &req->stock);
+	case REMOTE_CUSTOMER:
+		return payment_customer(t_num, arg, &req->cust);
+	}
+	return 0;
+}
+
+/*
+ * run the requests waiting for this thread, one transaction per sender.
+ * must not be called inside the thread's own transaction.
+ * returns the number of requests served.
+ */
+int remote_serve(int t_num, thread_arg *arg)
+{
+	remote_req_t *batch[RING_SIZE];
+	int s, i, n, ok, failed, served = 0;
+
+	for (s = 0; s < num_threads; s++) {
+		for (n = 0; n < RING_SIZE; n++) {
+			batch[n] = ring_pop(ring_of(t_num, s));
+			if (batch[n] == NULL)
+				break;
+		}
+		if (n == 0)
+			continue;
+
+		/* IMMEDIATE would lock the shared main file as well */
+		ok = tx_ctl(arg, CTL_DEFERRED) == SQLITE_OK;
+		failed = -1;
+		for (i = 0; i < n && ok; i++) {
+			ok = run_req(t_num, arg, batch[i]);
+			if (!ok)
+				failed = i;
+		}
+		if (ok)
+			ok = tx_ctl(arg, CTL_COMMIT) == SQLITE_OK;
+		if (!ok) {
+			/* every request is lost, the failing one counted itself */
+			for (i = 0; i < n; i++) {
+				if (i != failed)
+					tx_error(arg, req_tx[batch[i]->op],
+						 ERR_PHASE_CTL);
+			}
+			tx_abort_stmts(arg->ctx);
+			if (!sqlite3_get_autocommit(arg->ctx))
+				tx_ctl(arg, CTL_ROLLBACK);
+		}
+
+		for (i = 0; i < n; i++) {
+			batch[i]->ok = ok;
+			__atomic_store_n(&batch[i]->done, 1, __ATOMIC_RELEASE);
+		}
+		served += n;
+	}
+	return served;
+}
+
+static void ship(int t_num, remote_req_t *req, int owner, thread_arg *arg)
+{
+	req->ok = 0;
+	req->done = 0;
+	while (ring_push(ring_of(owner, t_num), req)) {
+		if (!remote_serve(t_num, arg))
+			sched_yield();
+	}
+}
+
+/*
+ * build the requests for the parts of in that touch other threads'
+ * warehouses, before its first attempt
+ */
+void remote_prepare(int t_num, thread_arg *arg, const tx_input_t *in)
+{
+	remote_ctx_t *ctx = arg->remote;
+	remote_req_t *req;
+	int i, owner;
+
+	for (i = 0; i < MAX_NUM_ITEMS; i++) {
+		ctx->line[i].op = REMOTE_NONE;
+		ctx->line[i].ok = 0;
+	}
+
+	switch (in->tx) {
+	case TX_NEWORD:
+		for (i = 0; i < in->neword.ol_cnt; i++) {
+			owner = shard_of(in->neword.supware[i]);
+			if (owner == t_num)
+				continue;
+			req = &ctx->line[i];
+			req->op = REMOTE_STOCK;
+			req->stock.i_id = in->neword.itemid[i];
+			req->stock.w_id = in->neword.supware[i];
+			req->stock.d_id = in->d_id;
+			req->stock.qty = in->neword.qty[i];
+			req->owner = owner;
+		}
+		break;
+	case TX_PAYMENT:
+		owner = shard_of(in->payment.c_w_id);
+		if (owner == t_num)
+			break;
+		req = &ctx->line[0];
+		req->op = REMOTE_CUSTOMER;
+		req->cust.byname = in->payment.byname;
+		req->cust.c_w_id = in->payment.c_w_id;
+		req->cust.c_d_id = in->payment.c_d_id;
+		req->cust.c_id = in->payment.c_id;
+		strcpy(req->cust.c_last, in->payment.c_last);
+		req->cust.h_amount = in->payment.h_amount;
+		req->cust.w_id = in->w_id;
+		req->cust.d_id = in->d_id;
+		gettimestamp(req->cust.datetime, STRFTIME_FORMAT,
+			     TIMESTAMP_LEN);
+		req->owner = owner;
+		break;
+	}
+}
+
+/*
+ * ship the prepared requests not committed yet and wait until their
+ * owners are done with them. returns 1 if one of them failed.
+ */
+int remote_ship(int t_num, thread_arg *arg)
+{
+	remote_ctx_t *ctx = arg->remote;
+	remote_req_t *req;
+	int i, n = 0, ok = 1;
+
+	for (i = 0; i < MAX_NUM_ITEMS; i++) {
+		req = &ctx->line[i];
+		if (req->op == REMOTE_NONE || req->ok)
+			continue;
+		ship(t_num, req, req->owner, arg);
+		n++;
+	}
+	if (n == 0)
+		return 0;
+
+	for (i = 0; i < MAX_NUM_ITEMS; i++) {
+		req = &ctx->line[i];
+		if (req->op == REMOTE_NONE)
+			continue;
+		while (!__atomic_load_n(&req->done, __ATOMIC_ACQUIRE)) {
+			if (!remote_serve(t_num, arg))
+				sched_yield();
+		}
+		ok &= req->ok;
+	}
+	return !ok;
+}
+
+/* the local part of the prepared tx failed for good */
+void remote_abandon(thread_arg *arg)
+{
+	int i;
+
+	for (i = 0; i < MAX_NUM_ITEMS; i++) {
+		if (arg->remote->line[i].op != REMOTE_NONE &&
+		    arg->remote->line[i].ok) {
+			__atomic_add_fetch(&orphans, 1, __ATOMIC_RELAXED);
+			return;
+		}
+	}
+}
+
+void remote_report(void)
+{
+	printf("\n<Shared-nothing> txs whose remote part committed without the local part: %lu\n",
+	       __atomic_load_n(&orphans, __ATOMIC_RELAXED));
+}
+
+/* done with transactions: keep serving until every thread is */
+void remote_leave(int t_num, thread_arg *arg)
+{
+	struct timespec ts = { 0, 100000 };
+
+	__atomic_sub_fetch(&running, 1, __ATOMIC_ACQ_REL);
+	while (__atomic_load_n(&running, __ATOMIC_ACQUIRE) > 0) {
+		if (!remote_serve(t_num, arg))
+			nanosleep(&ts, NULL);
+	}
+	remote_serve(t_num, arg);
+}
@@ -0,0 +1,92 @@
+/*
+ * remote.h
+ * shared-nothing mode: work on warehouses owned by other threads
+ *
+ * With -N every worker owns one shard file (a contiguous warehouse
+ * range) and is the only one to open it. The remote supply lines of
+ * New-Order and the remote customers of Payment are shipped to the
+ * owner as requests over single-producer single-consumer rings, one
+ * ring per (sender, owner) pair. A remote part commits on its own,
+ * ahead of the local part (see remote.c).
+ */
+
+#ifndef _TPCC_REMOTE_H_
+#define _TPCC_REMOTE_H_
+
+#include "main.h"
+
+enum remote_op {
+	REMOTE_NONE,
+	REMOTE_STOCK, /* New-Order: read and update one stock row */
+	REMOTE_CUSTOMER /* Payment: find and charge one customer */
+};
+
+/* one New-Order supply line */
+typedef struct {
+	int i_id;
+	int w_id; /* supplying warehouse */
+	int d_id; /* picks s_dist_xx */
+	int qty;
+	/* out, as read before the update */
+	int s_quantity;
+	char s_data[51];
+	char dist_info[25];
+} remote_stock_t;
+
+/* the customer part of Payment */
+typedef struct {
+	int byname;
+	int c_w_id;
+	int c_d_id;
+	int c_id; /* in, or out when byname */
+	char c_last[17];
+	float h_amount;
+	int w_id; /* paying warehouse and district, for c_data */
+	int d_id;
+	char datetime[81];
+} remote_cust_t;
+
+typedef struct remote_req {
+	int op;
+	int owner; /* thread of the warehouse */
+	int ok; /* out: the owner committed it */
+	int done; /* set last by the owner */
+	union {
+		remote_stock_t stock;
+		remote_cust_t cust;
+	};
+} remote_req_t;
+
+/* per thread: the requests of the tx being run */
+typedef struct remote_ctx {
+	remote_req_t line[MAX_NUM_ITEMS]; /* Payment uses line[0] */
+} __attribute__((aligned(CACHE_LINE_SIZE))) remote_ctx_t;
+
+extern int shared_nothing;
+
+int remote_init(int nthreads);
+remote_ctx_t *remote_get(int t_num);
+void remote_done(void);
+void remote_prepare(int t_num, thread_arg *arg, const tx_input_t *in);
+int remote_ship(int t_num, thread_arg *arg);
+void remote_abandon(thread_arg *arg);
+void remote_report(void);
+int remote_serve(int t_num, thread_arg *arg);
+void remote_leave(int t_num, thread_arg *arg);
+
+/* results of the shipped parts, NULL when that part is local */
+static inline remote_stock_t *remote_stock_line(thread_arg *arg, int line)
+{
+	if (arg->remote == NULL || arg->remote->line[line].op != REMOTE_STOCK)
+		return NULL;
+	return &arg->remote->line[line].stock;
+}
+
+static inline remote_cust_t *remote_customer(thread_arg *arg)
+{
+	if (arg->remote == NULL || arg->remote->line[0].op != REMOTE_CUSTOMER)
+		return NULL;
+	return &arg->remote->line[0].cust;
+}
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * rpool.c
+ * read-only connection pool for Order-Status and Stock-Level
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rpool.h"
+#include "lockwait.h"
+
+int ro_pool_size = 0;
+
+static ro_conn_t *slots;
+static ro_conn_t *free_list;
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t avail = PTHREAD_COND_INITIALIZER;
+
+/* updated under mtx */
+static uint64_t n_borrows, n_waits;
+static double wait_sec;
+
+/* the slots are opened by the caller, see ro_pool_slot() */
+int ro_pool_init(void)
+{
+	int i;
+
+	slots = calloc(ro_pool_size, sizeof(ro_conn_t));
+	if (slots == NULL)
+		return 1;
+	for (i = ro_pool_size - 1; i >= 0; i--) {
+		slots[i].next = free_list;
+		free_list = &slots[i];
+	}
+	return 0;
+}
+
+ro_conn_t *ro_pool_slot(int i)
+{
+	return &slots[i];
+}
+
+void ro_pool_done(void)
+{
+	free(slots);
+	slots = NULL;
+	free_list = NULL;
+}
+
+static void use_conn(thread_arg *arg, const ro_conn_t *c)
+{
+	arg->ctx = c->ctx;
+	arg->stmt = c->stmt;
+	memcpy(arg->ctl, c->ctl, sizeof(arg->ctl));
+}
+
+/*
+ * borrow a pooled connection: it takes the place of arg's own one,
+ * which is kept in save until ro_pool_leave()
+ */
+void ro_pool_enter(thread_arg *arg, ro_conn_t *save)
+{
+	ro_conn_t *c;
+	double t0;
+
+	pthread_mutex_lock(&mtx);
+	if (free_list == NULL) {
+		n_waits++;
+		t0 = clock_sec(CLOCK_MONOTONIC);
+		while (free_list == NULL)
+			pthread_cond_wait(&avail, &mtx);
+		wait_sec += clock_sec(CLOCK_MONOTONIC) - t0;
+	}
+	c = free_list;
+	free_list = c->next;
+	n_borrows++;
+	pthread_mutex_unlock(&mtx);
+
+	save->ctx = arg->ctx;
+	save->stmt = arg->stmt;
+	memcpy(save->ctl, arg->ctl, sizeof(save->ctl));
+	save->next = c; /* the slot to give back */
+	use_conn(arg, c);
+	/* busy waits are charged to the borrower */
+	busy_install(arg);
+}
+
+void ro_pool_leave(thread_arg *arg, ro_conn_t *save)
+{
+	ro_conn_t *c = save->next;
+
+	use_conn(arg, save);
+
+	pthread_mutex_lock(&mtx);
+	c->next = free_list;
+	free_list = c;
+	pthread_cond_signal(&avail);
+	pthread_mutex_unlock(&mtx);
+}
+
+void ro_pool_report(void)
+{
+	printf("\n<Read-only Pool>\n");
+	printf("  connections: %d, borrowed: %lu, waited: %lu (%.1f%%, %.3f sec.)\n",
+	       ro_pool_size, n_borrows, n_waits,
+	       n_borrows ? 100.0 * n_waits / n_borrows : 0.0, wait_sec);
+}
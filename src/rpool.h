@@ -0,0 +1,33 @@
+/*
+ * rpool.h
+ * read-only connection pool for Order-Status and Stock-Level
+ *
+ * With -P n the read-only txs run on one of n connections opened with
+ * SQLITE_OPEN_READONLY and PRAGMA query_only, shared by all workers,
+ * so in WAL mode they never go near the write path of the workers'
+ * own connections. A worker borrows a connection for one attempt by
+ * swapping it into its thread_arg.
+ */
+
+#ifndef _TPCC_RPOOL_H_
+#define _TPCC_RPOOL_H_
+
+#include "main.h"
+
+typedef struct ro_conn {
+	sqlite3 *ctx;
+	sqlite3_stmt **stmt;
+	sqlite3_stmt *ctl[CTL_NUMS];
+	struct ro_conn *next; /* free list */
+} ro_conn_t;
+
+extern int ro_pool_size; /* 0: readers use the worker's connection */
+
+int ro_pool_init(void);
+ro_conn_t *ro_pool_slot(int i);
+void ro_pool_done(void);
+void ro_pool_enter(thread_arg *arg, ro_conn_t *save);
+void ro_pool_leave(thread_arg *arg, ro_conn_t *save);
+void ro_pool_report(void);
+
+#endif
@@ -1,139 +1,190 @@
 /*
  * rthist.c
  * RT-histgram
+ *
+ * Response times are kept per transaction type in microseconds, in
+ * log-linear histograms (see hdr_hist.c). Every worker records into its
+ * own shard; hist_ckp() merges the shards into the interval histogram
+ * and adds that to the whole-run histogram.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 
-#define MAXREC 20
-#define REC_PER_SEC 1000
+#include "hdr_hist.h"
+#include "rthist.h"
 
-extern double max_rt[];
-extern double cur_max_rt[];
+#define MAX_RT_USEC (3600LL * 1000000) /* 1 hour */
+#define SIGNIFICANT_FIGURES 2
 
-int total_hist[5][MAXREC * REC_PER_SEC];
-int cur_hist[5][MAXREC * REC_PER_SEC];
+extern const char *tx_name[];
+
+static int num_shards;
+static hdr_hist_t *shards; /* [num_shards][HIST_TX_NUMS] */
+static int64_t *snap[HIST_TX_NUMS]; /* merged counts at last checkpoint */
+static hdr_hist_t cur_hist[HIST_TX_NUMS];
+static hdr_hist_t total_hist[HIST_TX_NUMS];
+
+static FILE *hist_log;
+static double hist_log_start;
+static double hist_log_last;
+
+static double now_sec()
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
 
 /* initialize */
-void hist_init()
+int hist_init(int nthreads)
 {
 	int i, j;
 
-	for (i = 0; i < 5; i++) {
-		for (j = 0; j < (MAXREC * REC_PER_SEC); j++) {
-			total_hist[i][j] = cur_hist[i][j] = 0;
-		}
+	num_shards = nthreads;
+	shards = calloc((size_t)nthreads * HIST_TX_NUMS, sizeof(hdr_hist_t));
+	if (shards == NULL)
+		return 1;
+	for (i = 0; i < nthreads * HIST_TX_NUMS; i++) {
+		if (hdr_hist_init(&shards[i], MAX_RT_USEC, SIGNIFICANT_FIGURES))
+			return 1;
+	}
+	for (j = 0; j < HIST_TX_NUMS; j++) {
+		if (hdr_hist_init(&cur_hist[j], MAX_RT_USEC,
+				  SIGNIFICANT_FIGURES) ||
+		    hdr_hist_init(&total_hist[j], MAX_RT_USEC,
+				  SIGNIFICANT_FIGURES))
+			return 1;
+		snap[j] = calloc(cur_hist[j].counts_len, sizeof(int64_t));
+		if (snap[j] == NULL)
+			return 1;
 	}
+	return 0;
+}
+
+/* incliment matched one (rtclk in msec., called by the owning thread only) */
+void hist_inc(int t_num, int transaction, double rtclk)
+{
+	hdr_hist_record(&shards[t_num * HIST_TX_NUMS + transaction],
+			(int64_t)(rtclk * 1000.0 + 0.5));
 }
 
-/* incliment matched one */
-void hist_inc(int transaction, double rtclk)
+/* merge the shards of one tx type; cur_hist gets the growth since last call */
+static void merge(int transaction)
 {
-	int i;
+	hdr_hist_t *h = &cur_hist[transaction];
+	int64_t sum;
+	int i, t;
 
-	i = (rtclk * (double)REC_PER_SEC);
-	if (i >= (MAXREC * REC_PER_SEC)) {
-		i = (MAXREC * REC_PER_SEC) - 1;
+	for (i = 0; i < h->counts_len; i++) {
+		sum = 0;
+		for (t = 0; t < num_shards; t++)
+			sum += __atomic_load_n(
+				&shards[t * HIST_TX_NUMS + transaction].counts[i],
+				__ATOMIC_RELAXED);
+		h->counts[i] = sum - snap[transaction][i];
+		snap[transaction][i] = sum;
 	}
-	if (rtclk > cur_max_rt[transaction])
-		cur_max_rt[transaction] = rtclk;
-	++cur_hist[transaction][i];
-	//printf("In: %.3f, trx: %d, Added %d\n", rtclk, transaction, i);
+	hdr_hist_recount(h);
 }
 
-/* check point, add on total histgram, return 90% line */
-double hist_ckp(int transaction)
+/* check point, close the interval and add it on total histgram */
+void hist_ckp()
 {
-	int i;
-	int total, tmp, line, line_set;
-
-	total = tmp = line_set = 0;
-	line = MAXREC * REC_PER_SEC;
-	for (i = 0; i < (MAXREC * REC_PER_SEC); i++) {
-		total += cur_hist[transaction][i];
-		//total += i;
+	double now;
+	int j;
+
+	for (j = 0; j < HIST_TX_NUMS; j++) {
+		merge(j);
+		hdr_hist_add(&total_hist[j], &cur_hist[j]);
 	}
-	for (i = 0; i < (MAXREC * REC_PER_SEC); i++) {
-		tmp += cur_hist[transaction][i];
-		//tmp += i;
-		total_hist[transaction][i] += cur_hist[transaction][i];
-		cur_hist[transaction][i] = 0;
-		if ((tmp >= (total * 99 / 100)) && (line_set == 0)) {
-			line = i;
-			line_set = 1;
-		}
+
+	if (hist_log) {
+		now = now_sec();
+		for (j = 0; j < HIST_TX_NUMS; j++)
+			hdr_hist_log_interval(hist_log, &cur_hist[j], tx_name[j],
+					      hist_log_last - hist_log_start,
+					      now - hist_log_last, 1000.0);
+		fflush(hist_log);
+		hist_log_last = now;
 	}
-	//printf("CKP: trx: %d line: %d total: %d tmp: %d ret: %.3f\n",  transaction, line, total, tmp,(double)(line)/(double)(REC_PER_SEC));
-	return ((double)(line) / (double)(REC_PER_SEC));
 }
 
-void hist_report()
+/* forget everything recorded so far (end of ramp-up) */
+void hist_reset()
 {
-	int i, j;
-	int total[5], tmp[5], line[5];
-
-	for (j = 0; j < 5; j++) {
-		total[j] = tmp[j] = 0;
-		line[j] = MAXREC * REC_PER_SEC;
-		for (i = 0; i < (MAXREC * REC_PER_SEC); i++) {
-			total[j] += total_hist[j][i];
-		}
-		for (i = (MAXREC * REC_PER_SEC) - 1; i >= 0; i--) {
-			tmp[j] += total_hist[j][i];
-			if ((tmp[j] * 10) <= total[j]) {
-				line[j] = i;
-			}
-		}
-	}
+	int j;
 
-	printf("\n<RT Histogram>\n");
-
-	for (j = 0; j < 5; j++) {
-		switch (j) {
-		case 0:
-			printf("\n1.New-Order\n\n");
-			break;
-		case 1:
-			printf("\n2.Payment\n\n");
-			break;
-		case 2:
-			printf("\n3.Order-Status\n\n");
-			break;
-		case 3:
-			printf("\n4.Delivery\n\n");
-			break;
-		case 4:
-			printf("\n5.Stock-Level\n\n");
-		}
-		for (i = 0; (i < (MAXREC * REC_PER_SEC)) && (i <= line[j] * 4);
-		     i++) {
-			printf("%3.2f, %6d\n",
-			       (double)(i + 1) / (double)(REC_PER_SEC),
-			       total_hist[j][i]);
-		}
-		printf("\n");
+	for (j = 0; j < HIST_TX_NUMS; j++) {
+		merge(j);
+		hdr_hist_reset(&cur_hist[j]);
+		hdr_hist_reset(&total_hist[j]);
 	}
+	if (hist_log)
+		hist_log_last = now_sec();
+}
+
+/* percentile / max / mean of the last interval, in msec. */
+double hist_percentile(int transaction, double percent)
+{
+	return hdr_hist_value_at_percentile(&cur_hist[transaction], percent) /
+	       1000.0;
+}
+
+double hist_max(int transaction)
+{
+	return hdr_hist_max(&cur_hist[transaction]) / 1000.0;
+}
+
+/* same over the whole run */
+double hist_total_percentile(int transaction, double percent)
+{
+	return hdr_hist_value_at_percentile(&total_hist[transaction],
+					    percent) /
+	       1000.0;
+}
+
+double hist_total_max(int transaction)
+{
+	return hdr_hist_max(&total_hist[transaction]) / 1000.0;
+}
+
+double hist_total_mean(int transaction)
+{
+	return hdr_hist_mean(&total_hist[transaction]) / 1000.0;
+}
+
+/* HdrHistogram interval log, one tagged line per tx type per interval */
+int hist_log_open(const char *path)
+{
+	hist_log = fopen(path, "w");
+	if (hist_log == NULL)
+		return 1;
+	hist_log_start = hist_log_last = now_sec();
+	return hdr_hist_log_header(hist_log, hist_log_start);
+}
+
+void hist_log_close()
+{
+	if (hist_log)
+		fclose(hist_log);
+	hist_log = NULL;
+}
+
+void hist_report()
+{
+	int j;
 
-	printf("\n<90th Percentile RT (MaxRT)>\n");
-	for (j = 0; j < 5; j++) {
-		switch (j) {
-		case 0:
-			printf("   New-Order : ");
-			break;
-		case 1:
-			printf("     Payment : ");
-			break;
-		case 2:
-			printf("Order-Status : ");
-			break;
-		case 3:
-			printf("    Delivery : ");
-			break;
-		case 4:
-			printf(" Stock-Level : ");
-		}
-		printf("%3.2f  (%.2f)\n",
-		       (double)(line[j]) / (double)(REC_PER_SEC), max_rt[j]);
+	printf("\n<RT Percentiles (msec.)>\n");
+	printf("                  p50       p95       p99     p99.9       max\n");
+	for (j = 0; j < HIST_TX_NUMS; j++) {
+		printf("%12s : %9.3f %9.3f %9.3f %9.3f %9.3f\n", tx_name[j],
+		       hist_total_percentile(j, 50.0),
+		       hist_total_percentile(j, 95.0),
+		       hist_total_percentile(j, 99.0),
+		       hist_total_percentile(j, 99.9), hist_total_max(j));
 	}
 }
@@ -2,7 +2,17 @@
  * rthist.h
  */
 
-void hist_init();
-void hist_inc(int transaction, double rtclk);
-double hist_ckp(int transaction);
+#define HIST_TX_NUMS 5
+
+int hist_init(int nthreads);
+void hist_inc(int t_num, int transaction, double rtclk);
+void hist_ckp();
+void hist_reset();
+double hist_percentile(int transaction, double percent);
+double hist_max(int transaction);
+double hist_total_percentile(int transaction, double percent);
+double hist_total_max(int transaction);
+double hist_total_mean(int transaction);
+int hist_log_open(const char *path);
+void hist_log_close();
 void hist_report();
@@ -25,21 +25,34 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include <pthread.h>
 
 #include "sb_percentile.h"
 
+/* keep every shard on its own cache lines */
+#define SHARD_ALIGN (64 / sizeof(unsigned long long))
+
 int sb_percentile_init(sb_percentile_t *percentile, unsigned int size,
-		       double range_min, double range_max)
+		       double range_min, double range_max,
+		       unsigned int nshards)
 {
-	percentile->values =
+	percentile->stride = (size + SHARD_ALIGN - 1) / SHARD_ALIGN * SHARD_ALIGN;
+	percentile->values = (unsigned long long *)aligned_alloc(
+		64, (size_t)percentile->stride * nshards *
+			    sizeof(unsigned long long));
+	percentile->snap =
+		(unsigned long long *)calloc(size, sizeof(unsigned long long));
+	percentile->interval =
 		(unsigned long long *)calloc(size, sizeof(unsigned long long));
-	percentile->tmp =
+	percentile->run =
 		(unsigned long long *)calloc(size, sizeof(unsigned long long));
-	if (percentile->values == NULL || percentile->tmp == NULL) {
+	if (percentile->values == NULL || percentile->snap == NULL ||
+	    percentile->interval == NULL || percentile->run == NULL) {
 		//log_text(LOG_FATAL, "Cannot allocate values array, size = %u", size);
 		return 1;
 	}
+	memset(percentile->values, 0,
+	       (size_t)percentile->stride * nshards *
+		       sizeof(unsigned long long));
 
 	percentile->range_deduct = log(range_min);
 	percentile->range_mult =
@@ -47,15 +60,18 @@ int sb_percentile_init(sb_percentile_t *percentile, unsigned int size,
 	percentile->range_min = range_min;
 	percentile->range_max = range_max;
 	percentile->size = size;
-	percentile->total = 0;
-
-	pthread_mutex_init(&percentile->mutex, NULL);
+	percentile->nshards = nshards;
+	percentile->interval_total = 0;
+	percentile->run_total = 0;
 
 	return 0;
 }
 
-void sb_percentile_update(sb_percentile_t *percentile, double value)
+/* called only by the thread owning the shard */
+void sb_percentile_update(sb_percentile_t *percentile, unsigned int shard,
+			  double value)
 {
+	unsigned long long *bucket;
 	unsigned int n;
 
 	if (value < percentile->range_min)
@@ -67,33 +83,57 @@ void sb_percentile_update(sb_percentile_t *percentile, double value)
 			  percentile->range_mult +
 		  0.5);
 
-	pthread_mutex_lock(&percentile->mutex);
-	percentile->total++;
-	percentile->values[n]++;
-	pthread_mutex_unlock(&percentile->mutex);
+	bucket = &percentile->values[(size_t)shard * percentile->stride + n];
+	__atomic_store_n(bucket, __atomic_load_n(bucket, __ATOMIC_RELAXED) + 1,
+			 __ATOMIC_RELAXED);
 }
 
-double sb_percentile_calculate(sb_percentile_t *percentile, double percent)
+/* merge all shards; returns the counts recorded since the last call */
+static unsigned long long merge_shards(sb_percentile_t *percentile)
+{
+	unsigned long long cur, total = 0;
+	unsigned int i, s;
+
+	for (i = 0; i < percentile->size; i++) {
+		cur = 0;
+		for (s = 0; s < percentile->nshards; s++)
+			cur += __atomic_load_n(
+				&percentile->values[(size_t)s * percentile->stride + i],
+				__ATOMIC_RELAXED);
+		percentile->interval[i] = cur - percentile->snap[i];
+		percentile->snap[i] = cur;
+		total += percentile->interval[i];
+	}
+
+	return total;
+}
+
+/* close the current interval and add it to the whole-run histogram */
+void sb_percentile_checkpoint(sb_percentile_t *percentile)
 {
-	unsigned long long ncur, nmax;
 	unsigned int i;
 
-	pthread_mutex_lock(&percentile->mutex);
+	percentile->interval_total = merge_shards(percentile);
+	for (i = 0; i < percentile->size; i++)
+		percentile->run[i] += percentile->interval[i];
+	percentile->run_total += percentile->interval_total;
+}
 
-	if (percentile->total == 0) {
-		pthread_mutex_unlock(&percentile->mutex);
-		return 0.0;
-	}
+static double calculate(sb_percentile_t *percentile,
+			unsigned long long *values, unsigned long long total,
+			double percent)
+{
+	unsigned long long ncur, nmax;
+	unsigned int i;
 
-	memcpy(percentile->tmp, percentile->values,
-	       percentile->size * sizeof(unsigned long long));
-	nmax = floor(percentile->total * percent / 100 + 0.5);
+	if (total == 0)
+		return 0.0;
 
-	pthread_mutex_unlock(&percentile->mutex);
+	nmax = floor(total * percent / 100 + 0.5);
 
-	ncur = percentile->tmp[0];
+	ncur = values[0];
 	for (i = 1; i < percentile->size; i++) {
-		ncur += percentile->tmp[i];
+		ncur += values[i];
 		if (ncur >= nmax)
 			break;
 	}
@@ -101,18 +141,37 @@ double sb_percentile_calculate(sb_percentile_t *percentile, double percent)
 	return exp((i) / percentile->range_mult + percentile->range_deduct);
 }
 
+/* percentile of the interval closed by the last checkpoint */
+double sb_percentile_calculate(sb_percentile_t *percentile, double percent)
+{
+	return calculate(percentile, percentile->interval,
+			 percentile->interval_total, percent);
+}
+
+/* percentile over all checkpointed intervals */
+double sb_percentile_calculate_total(sb_percentile_t *percentile,
+				     double percent)
+{
+	return calculate(percentile, percentile->run, percentile->run_total,
+			 percent);
+}
+
+/* drop everything recorded so far, e.g. at the end of ramp-up */
 void sb_percentile_reset(sb_percentile_t *percentile)
 {
-	pthread_mutex_lock(&percentile->mutex);
-	percentile->total = 0;
-	memset(percentile->values, 0,
+	merge_shards(percentile);
+	memset(percentile->interval, 0,
+	       percentile->size * sizeof(unsigned long long));
+	memset(percentile->run, 0,
 	       percentile->size * sizeof(unsigned long long));
-	pthread_mutex_unlock(&percentile->mutex);
+	percentile->interval_total = 0;
+	percentile->run_total = 0;
 }
 
 void sb_percentile_done(sb_percentile_t *percentile)
 {
-	pthread_mutex_destroy(&percentile->mutex);
 	free(percentile->values);
-	free(percentile->tmp);
+	free(percentile->snap);
+	free(percentile->interval);
+	free(percentile->run);
 }
@@ -20,29 +20,42 @@
 
 #include "timers.h"
 
-#ifdef HAVE_PTHREAD_H
-#include <pthread.h>
-#endif
-
+/*
+  Each worker thread records into its own shard of cumulative bucket
+  counts without locking. sb_percentile_checkpoint() merges the shards
+  and turns the growth since the previous checkpoint into the interval
+  histogram, which is also added to the whole-run histogram.
+*/
 typedef struct {
-	unsigned long long *values;
-	unsigned long long *tmp;
-	unsigned long long total;
+	unsigned long long *values; /* nshards * stride cumulative counts */
+	unsigned long long *snap; /* merged counts at the last checkpoint */
+	unsigned long long *interval; /* counts of the last interval */
+	unsigned long long *run; /* counts of all checkpointed intervals */
+	unsigned long long interval_total;
+	unsigned long long run_total;
 	unsigned int size;
+	unsigned int stride;
+	unsigned int nshards;
 	double range_min;
 	double range_max;
 	double range_deduct;
 	double range_mult;
-	pthread_mutex_t mutex;
 } sb_percentile_t;
 
 int sb_percentile_init(sb_percentile_t *percentile, unsigned int size,
-		       double range_min, double range_max);
+		       double range_min, double range_max,
+		       unsigned int nshards);
 
-void sb_percentile_update(sb_percentile_t *percentile, double value);
+void sb_percentile_update(sb_percentile_t *percentile, unsigned int shard,
+			  double value);
+
+void sb_percentile_checkpoint(sb_percentile_t *percentile);
 
 double sb_percentile_calculate(sb_percentile_t *percentile, double percent);
 
+double sb_percentile_calculate_total(sb_percentile_t *percentile,
+				     double percent);
+
 void sb_percentile_reset(sb_percentile_t *percentile);
 
 void sb_percentile_done(sb_percentile_t *percentile);
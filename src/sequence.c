@@ -1,11 +1,19 @@
 /*
  * sequence.c
- * manage sequence shared by threads
+ * manage sequence of transaction types
+ *
+ * Every thread owns a deck holding exactly one round of the configured
+ * mix; it is reshuffled locally when exhausted, so the mix is kept per
+ * thread without any shared state.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
+#include <string.h>
+
+#include "main.h"
+#include "tpc.h"
+#include "sequence.h"
 
 /* weight */
 static int no;
@@ -15,12 +23,9 @@ static int dl;
 static int sl;
 static int total;
 
-static pthread_mutex_t mutex;
-static int *seq;
-static int next_num;
-
-static void shuffle()
+static void shuffle(seq_deck_t *deck)
 {
+	int *seq = deck->seq;
 	int i, j, rnd, tmp;
 
 	for (i = 0, j = 0; i < no; i++, j++) {
@@ -39,7 +44,7 @@ static void shuffle()
 		seq[j] = 4;
 	}
 	for (i = 0, j = total - 1; j > 0; i++, j--) {
-		rnd = rand() % (j + 1);
+		rnd = RandomNumber(deck->rnd, 0, j);
 		tmp = seq[rnd + i];
 		seq[rnd + i] = seq[i];
 		seq[i] = tmp;
@@ -48,33 +53,44 @@ static void shuffle()
 
 void seq_init(int n, int p, int o, int d, int s)
 {
-	pthread_mutex_init(&mutex, NULL);
 	no = n;
 	py = p;
 	os = o;
 	dl = d;
 	sl = s;
 	total = n + p + o + d + s;
-	seq = malloc(sizeof(int) * total);
-	shuffle();
-	next_num = 0;
 }
 
-int seq_get()
+/*
+ * allocate a deck on its own cache lines. main() allocates the workers'
+ * decks before they start; afterwards only the owner of rnd draws from it.
+ */
+seq_deck_t *seq_deck_new(struct rnd_ctx *rnd)
 {
-	int retval;
-
-	pthread_mutex_lock(&mutex);
+	seq_deck_t *deck;
+	size_t size = sizeof(seq_deck_t) + sizeof(int) * total;
 
-	if (next_num >= total) {
-		shuffle();
-		next_num = 0;
-	}
+	size = (size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+	if (posix_memalign((void **)&deck, CACHE_LINE_SIZE, size))
+		return NULL;
+	deck->seq = (int *)(deck + 1);
+	deck->rnd = rnd;
+	shuffle(deck);
+	deck->next_num = 0;
+	return deck;
+}
 
-	retval = seq[next_num];
-	++next_num;
+void seq_deck_free(seq_deck_t *deck)
+{
+	free(deck);
+}
 
-	pthread_mutex_unlock(&mutex);
+int seq_get(seq_deck_t *deck)
+{
+	if (deck->next_num >= total) {
+		shuffle(deck);
+		deck->next_num = 0;
+	}
 
-	return (retval);
+	return deck->seq[deck->next_num++];
 }
@@ -2,5 +2,19 @@
  * sequence.h
  */
 
+#ifndef _TPCC_SEQUENCE_H_
+#define _TPCC_SEQUENCE_H_
+
+/* per-thread shuffled deck of transaction types */
+typedef struct seq_deck {
+	int *seq;
+	int next_num;
+	struct rnd_ctx *rnd; /* owner's generator */
+} seq_deck_t;
+
 void seq_init(int n, int p, int o, int d, int s);
-int seq_get();
+seq_deck_t *seq_deck_new(struct rnd_ctx *rnd);
+void seq_deck_free(seq_deck_t *deck);
+int seq_get(seq_deck_t *deck);
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * shard.c
+ * warehouse-sharded database files
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "shard.h"
+
+int num_db_shards = 0;
+int shard_ware = 1;
+
+/* tables that follow their warehouse into a shard */
+static const char *shard_tables[] = {
+	"warehouse", "district", "customer", "history",
+	"new_orders", "orders", "order_line", "stock",
+};
+
+#define NUM_SHARD_TABLES (sizeof(shard_tables) / sizeof(shard_tables[0]))
+
+void shard_init(int nshards, int nware)
+{
+	num_db_shards = nshards;
+	shard_ware = nware > 0 ? nware : 1;
+}
+
+char *shard_path(const char *dbpath, int k)
+{
+	return sqlite3_mprintf("%s.s%d", dbpath, k);
+}
+
+/* attach shard k of dbpath to db, as shard<k> */
+int shard_attach_one(sqlite3 *db, const char *dbpath, int k)
+{
+	char *path, *sql;
+	int rc;
+
+	path = shard_path(dbpath, k);
+	sql = sqlite3_mprintf("ATTACH DATABASE %Q AS shard%d;", path, k);
+	rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+	sqlite3_free(sql);
+	sqlite3_free(path);
+	return rc != SQLITE_OK;
+}
+
+/* attach every shard file of dbpath to db */
+int shard_attach(sqlite3 *db, const char *dbpath)
+{
+	int k;
+
+	if (num_db_shards > sqlite3_limit(db, SQLITE_LIMIT_ATTACHED, -1)) {
+		fprintf(stderr, "%d shards, but sqlite attaches at most %d\n",
+			num_db_shards, sqlite3_limit(db, SQLITE_LIMIT_ATTACHED, -1));
+		return 1;
+	}
+	for (k = 0; k < num_db_shards; k++) {
+		if (shard_attach_one(db, dbpath, k))
+			return 1;
+	}
+	return 0;
+}
+
+static int is_shard_table(const char *s, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < NUM_SHARD_TABLES; i++) {
+		if (strlen(shard_tables[i]) == len &&
+		    strncasecmp(shard_tables[i], s, len) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * qualify the warehouse dependent tables of sql with shard k
+ * (whole words only, so columns like o_w_id are left alone).
+ * the result is sqlite3_free()d by the caller.
+ */
+char *shard_sql(const char *sql, int k)
+{
+	sqlite3_str *out = sqlite3_str_new(NULL);
+	const char *p = sql, *w;
+
+	while (*p) {
+		if (!isalnum((unsigned char)*p) && *p != '_') {
+			sqlite3_str_appendchar(out, 1, *p++);
+			continue;
+		}
+		for (w = p; isalnum((unsigned char)*p) || *p == '_'; p++)
+			;
+		if (num_db_shards > 0 && is_shard_table(w, p - w))
+			sqlite3_str_appendf(out, "shard%d.", k);
+		sqlite3_str_append(out, w, (int)(p - w));
+	}
+	return sqlite3_str_finish(out);
+}
+
+/*
+ * loader: create the shard files with the schema of the warehouse
+ * dependent tables (and their indexes) found in the main file
+ */
+int shard_create(sqlite3 *db, const char *dbpath)
+{
+	sqlite3 *sdb;
+	sqlite3_stmt *src, *chk;
+	char *path;
+	int k, rc = 0;
+
+	if (sqlite3_prepare_v2(db,
+			       "SELECT type, name, sql FROM sqlite_master "
+			       "WHERE sql NOT NULL AND tbl_name <> 'item' "
+			       "AND name NOT LIKE 'sqlite_%' "
+			       "ORDER BY type = 'index'",
+			       -1, &src, NULL) != SQLITE_OK)
+		return 1;
+
+	for (k = 0; k < num_db_shards && rc == 0; k++) {
+		chk = NULL;
+		path = shard_path(dbpath, k);
+		printf("Creating shard %d: %s\n", k, path);
+		rc = sqlite3_open(path, &sdb) != SQLITE_OK;
+		sqlite3_free(path);
+		if (rc == 0)
+			rc = sqlite3_prepare_v2(sdb,
+						"SELECT 1 FROM sqlite_master "
+						"WHERE type = ? AND name = ?",
+						-1, &chk, NULL) != SQLITE_OK;
+		while (rc == 0 && sqlite3_step(src) == SQLITE_ROW) {
+			/* already there from an earlier (partial) load */
+			sqlite3_bind_text(chk, 1,
+					  (const char *)sqlite3_column_text(src, 0),
+					  -1, SQLITE_TRANSIENT);
+			sqlite3_bind_text(chk, 2,
+					  (const char *)sqlite3_column_text(src, 1),
+					  -1, SQLITE_TRANSIENT);
+			if (sqlite3_step(chk) != SQLITE_ROW)
+				rc = sqlite3_exec(sdb,
+						  (const char *)sqlite3_column_text(src, 2),
+						  NULL, NULL, NULL) != SQLITE_OK;
+			sqlite3_reset(chk);
+		}
+		if (rc)
+			printf("%s: shard %d: %s\n", __func__, k,
+			       sqlite3_errmsg(sdb));
+		sqlite3_finalize(chk);
+		sqlite3_reset(src);
+		sqlite3_close(sdb);
+	}
+	sqlite3_finalize(src);
+	return rc;
+}
+
+/*
+ * driver: make sure every shard file holds the warehouses shard_of()
+ * sends there (a file loaded with another mapping or warehouse count
+ * would silently miss rows)
+ */
+int shard_check(const char *dbpath)
+{
+	sqlite3 *db = NULL;
+	sqlite3_stmt *st;
+	char *sql;
+	int k, lo, hi, rc = 0;
+
+	if (sqlite3_open_v2(dbpath, &db, SQLITE_OPEN_READONLY, NULL) !=
+		    SQLITE_OK ||
+	    shard_attach(db, dbpath)) {
+		printf("%s: error: %s\n", __func__, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 1;
+	}
+	for (k = 0; k < num_db_shards && rc == 0; k++) {
+		sql = sqlite3_mprintf("SELECT min(w_id), max(w_id) "
+				      "FROM shard%d.warehouse", k);
+		rc = sqlite3_prepare_v2(db, sql, -1, &st, NULL) != SQLITE_OK;
+		sqlite3_free(sql);
+		if (rc) {
+			printf("%s: shard %d: %s\n", __func__, k,
+			       sqlite3_errmsg(db));
+			break;
+		}
+		lo = hi = 0;
+		if (sqlite3_step(st) == SQLITE_ROW) {
+			lo = sqlite3_column_int(st, 0);
+			hi = sqlite3_column_int(st, 1);
+		}
+		sqlite3_finalize(st);
+		if (lo != shard_lo(k) || hi != shard_hi(k)) {
+			fprintf(stderr, "shard %d holds warehouses %d-%d, expected %d-%d: reload with -S %d -w %d\n",
+				k, lo, hi, shard_lo(k), shard_hi(k),
+				num_db_shards, shard_ware);
+			rc = 1;
+		}
+	}
+	sqlite3_close(db);
+	return rc;
+}
@@ -0,0 +1,56 @@
+/*
+ * shard.h
+ * warehouse-sharded database files
+ *
+ * With -S n the warehouse dependent tables live in n files next to the
+ * main one (<db>.s0 .. <db>.s<n-1>), each holding a contiguous range of
+ * warehouses. They are ATTACHed as shard0 .. shard<n-1>; item stays in
+ * the main file.
+ */
+
+#ifndef _TPCC_SHARD_H_
+#define _TPCC_SHARD_H_
+
+#include <sqlite3.h>
+
+extern int num_db_shards; /* 0: everything in the main file */
+extern int shard_ware; /* warehouses spread over the shards */
+
+void shard_init(int nshards, int nware);
+
+/*
+ * owning shard of a warehouse, 0 when not sharded. the ranges are the
+ * ones affinity_assign() gives to partition:<num_db_shards>.
+ */
+static inline int shard_of(int w_id)
+{
+	if (num_db_shards <= 1)
+		return 0;
+	return (int)(((long long)w_id * num_db_shards - 1) / shard_ware);
+}
+
+/* first and last warehouse of shard k, the inverse of shard_of() */
+static inline int shard_lo(int k)
+{
+	return 1 + (int)((long long)shard_ware * k / num_db_shards);
+}
+
+static inline int shard_hi(int k)
+{
+	return (int)((long long)shard_ware * (k + 1) / num_db_shards);
+}
+
+/* number of statement sets to prepare, one per shard */
+static inline int shard_sets(void)
+{
+	return num_db_shards > 1 ? num_db_shards : 1;
+}
+
+char *shard_path(const char *dbpath, int k);
+int shard_attach(sqlite3 *db, const char *dbpath);
+int shard_attach_one(sqlite3 *db, const char *dbpath, int k);
+char *shard_sql(const char *sql, int k);
+int shard_create(sqlite3 *db, const char *dbpath);
+int shard_check(const char *dbpath);
+
+#endif
@@ -12,6 +12,9 @@
 #include "spt_proc.h"
 #include "tpc.h"
 #include "main.h"
+#include "lockwait.h"
+#include "errstat.h"
+#include "txphase.h"
 
 /*
  * the stock level transaction
@@ -33,11 +36,14 @@ int slev(int t_num, thread_arg *arg,
 	sqlite3_stmt *sqlite_stmt;
 	sqlite3_stmt *sqlite_stmt2;
 	int num_cols;
+	int proceed = 0;
 
 	/*EXEC SQL WHENEVER NOT FOUND GOTO sqlerr;*/
 	/*EXEC SQL WHENEVER SQLERROR GOTO sqlerr;*/
 
 	/* find the next order id */
+	proceed = 1;
+	txphase_mark(arg, TXP_SL_DISTRICT);
 #ifdef DEBUG
 	printf("select 1\n");
 #endif
@@ -46,12 +52,12 @@ int slev(int t_num, thread_arg *arg,
 	                FROM district
 	                WHERE d_id = :d_id
 			AND d_w_id = :w_id;*/
-	sqlite_stmt = arg->stmt[32];
+	sqlite_stmt = STMT(arg, 32, w_id);
 
 	sqlite3_bind_int64(sqlite_stmt, 1, d_id);
 	sqlite3_bind_int64(sqlite_stmt, 2, w_id);
 
-	ret = sqlite3_step(sqlite_stmt);
+	ret = tx_step(arg, sqlite_stmt);
 	if (ret != SQLITE_DONE) {
 		if (ret != SQLITE_ROW)
 			goto sqlerr;
@@ -76,14 +82,16 @@ int slev(int t_num, thread_arg *arg,
 	EXEC_SQL OPEN ord_line;
 
 	EXEC SQL WHENEVER NOT FOUND GOTO done;*/
-	sqlite_stmt = arg->stmt[33];
+	proceed = 2;
+	txphase_mark(arg, TXP_SL_STOCK);
+	sqlite_stmt = STMT(arg, 33, w_id);
 
-	sqlite3_bind_int64(sqlite_stmt, 1, d_id);
-	sqlite3_bind_int64(sqlite_stmt, 2, w_id);
+	sqlite3_bind_int64(sqlite_stmt, 1, w_id);
+	sqlite3_bind_int64(sqlite_stmt, 2, d_id);
 	sqlite3_bind_int64(sqlite_stmt, 3, d_next_o_id);
 	sqlite3_bind_int64(sqlite_stmt, 4, d_next_o_id);
 
-	while (sqlite3_step(sqlite_stmt) != SQLITE_DONE) {
+	while ((ret = tx_step(arg, sqlite_stmt)) == SQLITE_ROW) {
 		num_cols = sqlite3_column_count(sqlite_stmt);
 		if (num_cols != 1)
 			goto sqlerr;
@@ -94,13 +102,14 @@ int slev(int t_num, thread_arg *arg,
 			WHERE s_w_id = :w_id
 		        AND s_i_id = :ol_i_id
 			AND s_quantity < :level;*/
-		sqlite_stmt2 = arg->stmt[34];
+		proceed = 3;
+		sqlite_stmt2 = STMT(arg, 34, w_id);
 
-		sqlite3_bind_int64(sqlite_stmt, 1, w_id);
-		sqlite3_bind_int64(sqlite_stmt, 2, ol_i_id);
-		sqlite3_bind_int64(sqlite_stmt, 3, level);
+		sqlite3_bind_int64(sqlite_stmt2, 1, w_id);
+		sqlite3_bind_int64(sqlite_stmt2, 2, ol_i_id);
+		sqlite3_bind_int64(sqlite_stmt2, 3, level);
 
-		ret = sqlite3_step(sqlite_stmt2);
+		ret = tx_step(arg, sqlite_stmt2);
 		if (ret != SQLITE_DONE) {
 			if (ret != SQLITE_ROW)
 				goto sqlerr;
@@ -112,6 +121,8 @@ int slev(int t_num, thread_arg *arg,
 
 		sqlite3_reset(sqlite_stmt2);
 	}
+	if (ret != SQLITE_DONE)
+		goto sqlerr;
 
 	sqlite3_reset(sqlite_stmt);
 
@@ -122,22 +133,10 @@ done:
 	return (1);
 
 sqlerr:
-	fprintf(stderr, "slev\n");
-	printf("%s: error: %s\n", __func__, sqlite3_errmsg(arg->ctx));
+	tx_error(arg, TX_SLEV, proceed);
 	//error(ctx[t_num],mysql_stmt);
 	/*EXEC SQL WHENEVER SQLERROR GOTO sqlerrerr;*/
 	/*EXEC_SQL ROLLBACK WORK;*/
-	sqlite3_exec(arg->ctx, "ROLLBACK;", NULL, NULL, NULL);
-	return (0);
-
-sqlerr2:
-	fprintf(stderr, "slev\n");
-	printf("%s: error: %s\n", __func__, sqlite3_errmsg(arg->ctx));
-	//error(ctx[t_num],mysql_stmt2);
-	/*EXEC SQL WHENEVER SQLERROR GOTO sqlerrerr;*/
-	/*EXEC_SQL ROLLBACK WORK;*/
-	//mysql_stmt_free_result(mysql_stmt);
-	//mysql_rollback(ctx[t_num]);
-	sqlite3_exec(arg->ctx, "ROLLBACK;", NULL, NULL, NULL);
+	/* the caller rolls back */
 	return (0);
 }
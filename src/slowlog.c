@@ -0,0 +1,342 @@
+/*
+ * slowlog.c
+ * the slowest txs of every interval, with their context
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slowlog.h"
+#include "txphase.h"
+#include "ckpt.h"
+
+#define DEFAULT_FILE "tpcc_slow.log"
+#define MAX_SLOW 1000
+
+extern const char *tx_name[];
+
+typedef struct {
+	int interval;
+	int thread;
+	double start; /* sec. since slowlog_init() */
+	double rt; /* msec., first attempt to done */
+	double queued; /* msec. behind schedule before the first attempt */
+	int attempts;
+	int ok;
+	double busy_wait; /* msec., admission queue and busy handler */
+	uint64_t step_retries;
+	int ckpt; /* a checkpoint overlapped it, -1: no checkpointer */
+	int timed; /* ns[] holds the phases of the last attempt */
+	int64_t ns[TX_PHASES];
+	tx_input_t in;
+} slow_tx_t;
+
+typedef struct {
+	slow_tx_t *heap; /* min-heap on rt */
+	int n;
+	int interval;
+} __attribute__((aligned(CACHE_LINE_SIZE))) slow_shard_t;
+
+int slowlog_on = 0;
+
+static int slow_max;
+static char slow_file[256] = DEFAULT_FILE;
+
+static slow_shard_t *shards;
+static int num_shards;
+static double t_start;
+static int cur_interval = 1; /* bumped by the reporter */
+
+/* handed over by the workers */
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static slow_tx_t *all;
+static size_t n_all, cap_all;
+
+/* -O n[,file] */
+int slowlog_parse(const char *spec)
+{
+	const char *comma = strchr(spec, ',');
+
+	slow_max = atoi(spec);
+	if (slow_max < 1 || slow_max > MAX_SLOW)
+		return 1;
+	if (comma) {
+		if (comma[1] == '\0' || strlen(comma + 1) >= sizeof(slow_file))
+			return 1;
+		strcpy(slow_file, comma + 1);
+	}
+	slowlog_on = 1;
+	return 0;
+}
+
+const char *slowlog_describe(void)
+{
+	static char buf[320];
+
+	snprintf(buf, sizeof(buf), "%d per thread and interval, to %s",
+		 slow_max, slow_file);
+	return buf;
+}
+
+int slowlog_init(int nthreads)
+{
+	int t;
+
+	shards = aligned_alloc(CACHE_LINE_SIZE,
+			       sizeof(slow_shard_t) * nthreads);
+	if (shards == NULL)
+		return 1;
+	memset(shards, 0, sizeof(slow_shard_t) * nthreads);
+	num_shards = nthreads;
+	for (t = 0; t < nthreads; t++) {
+		shards[t].heap = calloc(slow_max, sizeof(slow_tx_t));
+		if (shards[t].heap == NULL)
+			return 1;
+		shards[t].interval = cur_interval;
+	}
+	t_start = clock_sec(CLOCK_MONOTONIC);
+	return 0;
+}
+
+void slowlog_done(void)
+{
+	int t;
+
+	for (t = 0; t < num_shards; t++)
+		free(shards[t].heap);
+	free(shards);
+	free(all);
+	shards = NULL;
+	all = NULL;
+	num_shards = 0;
+	n_all = cap_all = 0;
+}
+
+void slowlog_begin(thread_arg *arg, slow_snap_t *snap)
+{
+	snap->lock_wait = arg->time.lock_wait;
+	snap->step_retries = arg->step_retries;
+	snap->ckpt_gen = ckpt_on ? ckpt_generation() : 0;
+	/* a grouped tx is timed by the writer, not here */
+	arg->txp.seen = 0;
+}
+
+static void swap(slow_tx_t *a, slow_tx_t *b)
+{
+	slow_tx_t tmp = *a;
+
+	*a = *b;
+	*b = tmp;
+}
+
+static void sift_up(slow_tx_t *h, int i)
+{
+	while (i > 0 && h[i].rt < h[(i - 1) / 2].rt) {
+		swap(&h[i], &h[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+}
+
+static void sift_down(slow_tx_t *h, int n, int i)
+{
+	int c;
+
+	while ((c = 2 * i + 1) < n) {
+		if (c + 1 < n && h[c + 1].rt < h[c].rt)
+			c++;
+		if (h[i].rt <= h[c].rt)
+			break;
+		swap(&h[i], &h[c]);
+		i = c;
+	}
+}
+
+/* move the heap of s to the shared list */
+static void hand_over(slow_shard_t *s)
+{
+	slow_tx_t *p;
+	size_t cap;
+
+	if (s->n == 0)
+		return;
+	pthread_mutex_lock(&mtx);
+	if (n_all + s->n > cap_all) {
+		cap = cap_all ? cap_all * 2 : 256;
+		while (cap < n_all + s->n)
+			cap *= 2;
+		p = realloc(all, cap * sizeof(slow_tx_t));
+		if (p == NULL) {
+			/* keep what we have, drop this interval */
+			pthread_mutex_unlock(&mtx);
+			s->n = 0;
+			return;
+		}
+		all = p;
+		cap_all = cap;
+	}
+	memcpy(&all[n_all], s->heap, s->n * sizeof(slow_tx_t));
+	n_all += s->n;
+	pthread_mutex_unlock(&mtx);
+	s->n = 0;
+}
+
+static double ts_msec(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000.0 + ts->tv_nsec / 1000000.0;
+}
+
+/* a tx of the measurement window is done, after attempts attempts */
+void slowlog_end(thread_arg *arg, slow_snap_t *snap, const tx_input_t *in,
+		 const struct timespec *start, const struct timespec *end,
+		 int attempts, int ok)
+{
+	slow_shard_t *s = &shards[arg->number];
+	int iv = __atomic_load_n(&cur_interval, __ATOMIC_ACQUIRE);
+	unsigned gen;
+	slow_tx_t *e;
+	double rt;
+
+	if (s->interval != iv) {
+		hand_over(s);
+		s->interval = iv;
+	}
+	if (get_phase() != PHASE_MEASURE)
+		return;
+
+	rt = ts_msec(end) - ts_msec(start);
+	if (s->n == slow_max && rt <= s->heap[0].rt)
+		return;
+	e = s->n < slow_max ? &s->heap[s->n] : &s->heap[0];
+
+	e->interval = iv;
+	e->thread = arg->number;
+	e->start = ts_msec(start) / 1000.0 - t_start;
+	e->rt = rt;
+	e->queued = arg->scheduled ? ts_msec(start) - ts_msec(&arg->intended) :
+				     0.0;
+	e->attempts = attempts;
+	e->ok = ok;
+	e->busy_wait = (arg->time.lock_wait - snap->lock_wait) * 1000.0;
+	e->step_retries = arg->step_retries - snap->step_retries;
+	if (ckpt_on) {
+		gen = ckpt_generation();
+		e->ckpt = (snap->ckpt_gen & 1) || gen != snap->ckpt_gen;
+	} else {
+		e->ckpt = -1;
+	}
+	e->timed = arg->txp.seen != 0;
+	memcpy(e->ns, arg->txp.ns, sizeof(e->ns));
+	e->in = *in;
+
+	if (s->n < slow_max)
+		sift_up(s->heap, s->n++);
+	else
+		sift_down(s->heap, s->n, 0);
+}
+
+/* the worker is done */
+void slowlog_flush(thread_arg *arg)
+{
+	hand_over(&shards[arg->number]);
+}
+
+/* reporter: the interval is over */
+void slowlog_interval(void)
+{
+	__atomic_add_fetch(&cur_interval, 1, __ATOMIC_RELEASE);
+}
+
+/* by interval, slowest first */
+static int by_interval_rt(const void *a, const void *b)
+{
+	const slow_tx_t *x = a, *y = b;
+
+	if (x->interval != y->interval)
+		return x->interval - y->interval;
+	return (x->rt < y->rt) - (x->rt > y->rt);
+}
+
+static void write_input(FILE *f, const tx_input_t *in)
+{
+	int i;
+
+	fprintf(f, "  input: w_id %d", in->w_id);
+	switch (in->tx) {
+	case TX_NEWORD:
+		fprintf(f, " d_id %d c_id %d ol_cnt %d all_local %d\n",
+			in->d_id, in->neword.c_id, in->neword.ol_cnt,
+			in->neword.all_local);
+		fprintf(f, "  lines (i_id@supply_w_id x qty):");
+		for (i = 0; i < in->neword.ol_cnt; i++)
+			fprintf(f, " %d@%d x%d", in->neword.itemid[i],
+				in->neword.supware[i], in->neword.qty[i]);
+		break;
+	case TX_PAYMENT:
+		fprintf(f, " d_id %d c_w_id %d c_d_id %d", in->d_id,
+			in->payment.c_w_id, in->payment.c_d_id);
+		if (in->payment.byname)
+			fprintf(f, " c_last %s", in->payment.c_last);
+		else
+			fprintf(f, " c_id %d", in->payment.c_id);
+		fprintf(f, " h_amount %d", in->payment.h_amount);
+		break;
+	case TX_ORDSTAT:
+		fprintf(f, " d_id %d", in->d_id);
+		if (in->ordstat.byname)
+			fprintf(f, " c_last %s", in->ordstat.c_last);
+		else
+			fprintf(f, " c_id %d", in->ordstat.c_id);
+		break;
+	case TX_DELIVERY:
+		fprintf(f, " o_carrier_id %d", in->delivery.o_carrier_id);
+		break;
+	case TX_SLEV:
+		fprintf(f, " d_id %d threshold %d", in->d_id, in->slev.level);
+		break;
+	}
+	fprintf(f, "\n");
+}
+
+/* write every tx handed over, after the workers are done */
+int slowlog_write(void)
+{
+	static const char *ckpt_str[] = { "n/a", "no", "yes" };
+	const char *name;
+	slow_tx_t *e;
+	FILE *f;
+	size_t i;
+	int p;
+
+	f = fopen(slow_file, "w");
+	if (f == NULL)
+		return 1;
+	qsort(all, n_all, sizeof(slow_tx_t), by_interval_rt);
+	fprintf(f, "# %s\n", slowlog_describe());
+	fprintf(f, "# times in msec., start in sec.; busy: admission queue and busy handler; phases: last attempt\n");
+	for (i = 0; i < n_all; i++) {
+		e = &all[i];
+		fprintf(f, "interval %d thread %d %s rt %.3f queued %.3f start %.3f attempts %d %s\n",
+			e->interval, e->thread, tx_name[e->in.tx], e->rt,
+			e->queued, e->start, e->attempts,
+			e->ok ? "ok" : "failed");
+		fprintf(f, "  busy %.3f step_retries %lu checkpoint %s\n",
+			e->busy_wait, e->step_retries, ckpt_str[e->ckpt + 1]);
+		if (e->timed) {
+			fprintf(f, "  phases:");
+			for (p = 0; p < TX_PHASES; p++) {
+				name = txphase_name(e->in.tx, p);
+				if (name)
+					fprintf(f, " %s %.3f", name,
+						e->ns[p] / 1000000.0);
+			}
+			fprintf(f, "\n");
+		} else {
+			fprintf(f, "  phases: n/a (group commit)\n");
+		}
+		write_input(f, &e->in);
+	}
+	fclose(f);
+	printf("\n<Slow Transactions> %zu written to %s\n", n_all, slow_file);
+	return 0;
+}
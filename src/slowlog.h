@@ -0,0 +1,39 @@
+/*
+ * slowlog.h
+ * the slowest txs of every interval, with their context
+ *
+ * With -O n[,file] every worker keeps the n slowest txs it ran in the
+ * current report interval in a min-heap, the fastest of them on top, so
+ * a tx that is not slow costs one compare. A worker hands its heap over
+ * on its first tx after the reporter closed the interval (and when it
+ * is done); all of them are written to the file at the end, slowest
+ * first within each interval.
+ */
+
+#ifndef _TPCC_SLOWLOG_H_
+#define _TPCC_SLOWLOG_H_
+
+#include "main.h"
+
+/* taken before the first attempt */
+typedef struct {
+	double lock_wait; /* sec., arg->time.lock_wait */
+	uint64_t step_retries;
+	unsigned ckpt_gen;
+} slow_snap_t;
+
+extern int slowlog_on;
+
+int slowlog_parse(const char *spec);
+const char *slowlog_describe(void);
+int slowlog_init(int nthreads);
+void slowlog_done(void);
+void slowlog_begin(thread_arg *arg, slow_snap_t *snap);
+void slowlog_end(thread_arg *arg, slow_snap_t *snap, const tx_input_t *in,
+		 const struct timespec *start, const struct timespec *end,
+		 int attempts, int ok);
+void slowlog_flush(thread_arg *arg);
+void slowlog_interval(void);
+int slowlog_write(void);
+
+#endif
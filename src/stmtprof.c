@@ -0,0 +1,292 @@
+/*
+ * stmtprof.c
+ * per-statement profile of sql_statements[]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stmtprof.h"
+#include "main.h"
+#include "shard.h"
+
+#define TOP_STATEMENTS 15
+#define PLAN_LEN 512
+
+int stmtprof_on = 0;
+
+/*
+ * the totals, one cache line per statement: the stmt_status counters
+ * are added by each connection on teardown, the run times are merged
+ * from the connections' shards by stmtprof_report().
+ */
+typedef struct {
+	uint64_t count;
+	uint64_t nsec;
+	uint64_t max_nsec;
+	uint64_t vm_steps;
+	uint64_t fullscan_steps;
+	uint64_t sorts;
+	uint64_t autoindex;
+} __attribute__((aligned(CACHE_LINE_SIZE))) stmt_prof_t;
+
+static stmt_prof_t prof[NUM_SQL_STATEMENTS];
+
+/* run times of a statement on one connection */
+typedef struct {
+	uint64_t count;
+	uint64_t nsec;
+	uint64_t max_nsec;
+} stmt_run_t;
+
+/*
+ * one per connection, which only one thread uses at a time (a pool
+ * connection is lent out whole), so it is counted without atomics.
+ * its statements are found by address in an open addressing table.
+ */
+typedef struct stmt_shard {
+	struct stmt_shard *next;
+	unsigned mask; /* table size - 1 */
+	struct {
+		sqlite3_stmt *st;
+		int i; /* index of sql_statements[] */
+	} *table;
+	stmt_run_t run[NUM_SQL_STATEMENTS];
+} __attribute__((aligned(CACHE_LINE_SIZE))) stmt_shard_t;
+
+static pthread_mutex_t shards_mtx = PTHREAD_MUTEX_INITIALIZER;
+static stmt_shard_t *shards;
+static char plan[NUM_SQL_STATEMENTS][PLAN_LEN];
+static const char **sql_text;
+
+enum plan_flag { PF_SCAN = 1, PF_TEMP_BTREE = 2, PF_AUTOINDEX = 4 };
+static int plan_flags[NUM_SQL_STATEMENTS];
+
+static void plan_append(int i, const char *detail)
+{
+	size_t len = strlen(plan[i]);
+
+	snprintf(plan[i] + len, PLAN_LEN - len, "%s%s", len ? "; " : "",
+		 detail);
+	if (strncmp(detail, "SCAN ", 5) == 0)
+		plan_flags[i] |= PF_SCAN;
+	if (strstr(detail, "TEMP B-TREE"))
+		plan_flags[i] |= PF_TEMP_BTREE;
+	if (strstr(detail, "AUTOMATIC"))
+		plan_flags[i] |= PF_AUTOINDEX;
+}
+
+/* EXPLAIN QUERY PLAN of each statement, against shard 0 when sharded */
+int stmtprof_explain(const char *dbpath, const char **sql, int n)
+{
+	sqlite3 *db = NULL;
+	sqlite3_stmt *st;
+	char *q, *s;
+	int i, rc = 0;
+
+	sql_text = sql;
+	if (sqlite3_open_v2(dbpath, &db, SQLITE_OPEN_READONLY, NULL) !=
+		    SQLITE_OK ||
+	    shard_attach(db, dbpath)) {
+		printf("%s: error: %s\n", __func__,
+		       db ? sqlite3_errmsg(db) : "open failed");
+		sqlite3_close(db);
+		return 1;
+	}
+	for (i = 0; i < n && i < NUM_SQL_STATEMENTS && rc == 0; i++) {
+		s = shard_sql(sql[i], 0);
+		q = sqlite3_mprintf("EXPLAIN QUERY PLAN %s", s);
+		rc = sqlite3_prepare_v2(db, q, -1, &st, NULL) != SQLITE_OK;
+		while (rc == 0 && sqlite3_step(st) == SQLITE_ROW)
+			plan_append(i, (const char *)sqlite3_column_text(st, 3));
+		sqlite3_finalize(st);
+		sqlite3_free(q);
+		sqlite3_free(s);
+	}
+	if (rc)
+		printf("%s: statement %d: %s\n", __func__, i - 1,
+		       sqlite3_errmsg(db));
+	sqlite3_close(db);
+	return rc;
+}
+
+static unsigned stmt_hash(const stmt_shard_t *s, const sqlite3_stmt *st)
+{
+	return (unsigned)(((uintptr_t)st * 0x9e3779b97f4a7c15ULL) >> 32) &
+	       s->mask;
+}
+
+/* which of sql_statements[] st is, -1 for any other statement */
+static int stmt_index(const stmt_shard_t *s, const sqlite3_stmt *st)
+{
+	unsigned h;
+
+	for (h = stmt_hash(s, st); s->table[h].st; h = (h + 1) & s->mask) {
+		if (s->table[h].st == st)
+			return s->table[h].i;
+	}
+	return -1;
+}
+
+static int trace(unsigned type, void *ctx, void *p, void *x)
+{
+	stmt_shard_t *s = ctx;
+	uint64_t ns = *(sqlite3_int64 *)x;
+	stmt_run_t *r;
+	int i;
+
+	if (type != SQLITE_TRACE_PROFILE || (i = stmt_index(s, p)) < 0)
+		return 0;
+	r = &s->run[i];
+	r->count++;
+	r->nsec += ns;
+	if (ns > r->max_nsec)
+		r->max_nsec = ns;
+	return 0;
+}
+
+/* after the statements of the connection are prepared */
+int stmtprof_install(sqlite3 *db, sqlite3_stmt **stmt)
+{
+	int n = shard_sets() * NUM_SQL_STATEMENTS;
+	stmt_shard_t *s;
+	unsigned size = 1, h;
+	int k;
+
+	if (!stmtprof_on)
+		return 0;
+	while (size < 2 * (unsigned)n)
+		size <<= 1;
+	s = aligned_alloc(CACHE_LINE_SIZE, sizeof(stmt_shard_t));
+	if (s == NULL)
+		return 1;
+	memset(s, 0, sizeof(stmt_shard_t));
+	s->mask = size - 1;
+	s->table = calloc(size, sizeof(*s->table));
+	if (s->table == NULL) {
+		free(s);
+		return 1;
+	}
+	for (k = 0; k < n; k++) {
+		if (stmt[k] == NULL)
+			continue;
+		for (h = stmt_hash(s, stmt[k]); s->table[h].st;
+		     h = (h + 1) & s->mask)
+			;
+		s->table[h].st = stmt[k];
+		s->table[h].i = k % NUM_SQL_STATEMENTS;
+	}
+
+	pthread_mutex_lock(&shards_mtx);
+	s->next = shards;
+	shards = s;
+	pthread_mutex_unlock(&shards_mtx);
+	sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE, trace, s);
+	return 0;
+}
+
+/* add the stmt_status counters of a connection, before finalizing */
+void stmtprof_collect(sqlite3_stmt **stmt)
+{
+	stmt_prof_t *sp;
+	int k;
+
+	if (!stmtprof_on)
+		return;
+	for (k = 0; k < shard_sets() * NUM_SQL_STATEMENTS; k++) {
+		if (stmt[k] == NULL)
+			continue;
+		sp = &prof[k % NUM_SQL_STATEMENTS];
+		__atomic_fetch_add(&sp->vm_steps,
+				   sqlite3_stmt_status(stmt[k],
+						       SQLITE_STMTSTATUS_VM_STEP,
+						       0),
+				   __ATOMIC_RELAXED);
+		__atomic_fetch_add(&sp->fullscan_steps,
+				   sqlite3_stmt_status(stmt[k],
+						       SQLITE_STMTSTATUS_FULLSCAN_STEP,
+						       0),
+				   __ATOMIC_RELAXED);
+		__atomic_fetch_add(&sp->sorts,
+				   sqlite3_stmt_status(stmt[k],
+						       SQLITE_STMTSTATUS_SORT, 0),
+				   __ATOMIC_RELAXED);
+		__atomic_fetch_add(&sp->autoindex,
+				   sqlite3_stmt_status(stmt[k],
+						       SQLITE_STMTSTATUS_AUTOINDEX,
+						       0),
+				   __ATOMIC_RELAXED);
+	}
+}
+
+static int by_time(const void *a, const void *b)
+{
+	uint64_t x = prof[*(const int *)a].nsec, y = prof[*(const int *)b].nsec;
+
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/* the connections are done: add their run times to the totals */
+static void merge_shards(void)
+{
+	stmt_shard_t *s;
+	stmt_prof_t *sp;
+	int i;
+
+	for (s = shards; s; s = s->next) {
+		for (i = 0; i < NUM_SQL_STATEMENTS; i++) {
+			sp = &prof[i];
+			sp->count += s->run[i].count;
+			sp->nsec += s->run[i].nsec;
+			if (s->run[i].max_nsec > sp->max_nsec)
+				sp->max_nsec = s->run[i].max_nsec;
+		}
+	}
+}
+
+void stmtprof_report(void)
+{
+	int order[NUM_SQL_STATEMENTS];
+	stmt_prof_t *sp;
+	int i, k, flagged = 0;
+	char flags[16];
+
+	merge_shards();
+	for (i = 0; i < NUM_SQL_STATEMENTS; i++)
+		order[i] = i;
+	qsort(order, NUM_SQL_STATEMENTS, sizeof(int), by_time);
+
+	printf("\n<Top Statements> (whole run, by total time; S: full scan, T: temp b-tree, A: automatic index)\n");
+	printf("  stmt      count   total(s)  avg(us)  max(ms)  vm/exec  scan/exec sorts autoidx flags\n");
+	for (k = 0; k < TOP_STATEMENTS; k++) {
+		i = order[k];
+		sp = &prof[i];
+		if (sp->count == 0)
+			break;
+		/* from the plan, or seen at run time */
+		snprintf(flags, sizeof(flags), "%s%s%s",
+			 (plan_flags[i] & PF_SCAN) || sp->fullscan_steps ? "S" : "",
+			 plan_flags[i] & PF_TEMP_BTREE ? "T" : "",
+			 (plan_flags[i] & PF_AUTOINDEX) || sp->autoindex ? "A" : "");
+		flagged |= flags[0] != '\0';
+		printf("  %4d %10lu %10.3f %8.1f %8.3f %8.1f %10.1f %5lu %7lu %s\n",
+		       i, sp->count, sp->nsec / 1e9, sp->nsec / 1e3 / sp->count,
+		       sp->max_nsec / 1e6, (double)sp->vm_steps / sp->count,
+		       (double)sp->fullscan_steps / sp->count, sp->sorts,
+		       sp->autoindex, flags);
+	}
+	if (!flagged)
+		return;
+	printf("  plans of the flagged statements:\n");
+	for (k = 0; k < TOP_STATEMENTS; k++) {
+		i = order[k];
+		sp = &prof[i];
+		if (sp->count == 0)
+			break;
+		if (!plan_flags[i] && !sp->fullscan_steps && !sp->autoindex)
+			continue;
+		printf("  %4d %.70s\n       %s\n", i, sql_text ? sql_text[i] : "",
+		       plan[i]);
+	}
+}
@@ -0,0 +1,29 @@
+/*
+ * stmtprof.h
+ * per-statement profile of sql_statements[]
+ *
+ * With -T every connection reports the run time of each statement it
+ * steps to completion (trace_v2 SQLITE_TRACE_PROFILE), and on teardown
+ * the sqlite3_stmt_status() counters of its prepared statements: VM
+ * steps, full scan steps, sorts and automatic indexes. Each connection
+ * keeps its run times in a table of its own, keyed by statement
+ * address, so the threads share no counters while they run; at the end
+ * both are summed per index of sql_statements[] over shards and
+ * connections. The query plans are taken once at startup. The end of
+ * run table lists the statements by total time and flags full scans,
+ * temp b-trees and automatic indexes.
+ */
+
+#ifndef _TPCC_STMTPROF_H_
+#define _TPCC_STMTPROF_H_
+
+#include <sqlite3.h>
+
+extern int stmtprof_on;
+
+int stmtprof_explain(const char *dbpath, const char **sql, int n);
+int stmtprof_install(sqlite3 *db, sqlite3_stmt **stmt);
+void stmtprof_collect(sqlite3_stmt **stmt);
+void stmtprof_report(void);
+
+#endif
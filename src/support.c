@@ -17,40 +17,82 @@
 static int nums[CUST_PER_DIST];
 static int perm_count;
 
-void SetSeed(int seed)
-{
-	srand(seed);
-}
+/* NURand C constants, chosen once per run by NURand_init() */
+static unsigned C_255, C_1023, C_8191;
+static unsigned C_255_load; /* C_LAST the loader used, for the delta */
 
-void init_randomness()
+/*
+ * 64-bit seed from /dev/urandom (falls back to the time of day)
+ */
+uint64_t init_randomness()
 {
-	int seed;
+	uint64_t seed;
 	int fd = open("/dev/urandom", O_RDONLY);
-	if (fd == -1) {
+	if (fd == -1)
 		fd = open("/dev/random", O_RDONLY);
-		if (fd == -1) {
-			struct timeval tv;
-			gettimeofday(&tv, NULL);
-			seed = (tv.tv_sec ^ tv.tv_usec) * tv.tv_sec *
-				       tv.tv_usec ^
-			       tv.tv_sec;
-		} else {
-			read(fd, &seed, sizeof(seed));
-			close(fd);
-		}
-	} else {
-		read(fd, &seed, sizeof(seed));
-		close(fd);
+	if (fd == -1 || read(fd, &seed, sizeof(seed)) != sizeof(seed)) {
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		seed = ((uint64_t)tv.tv_sec << 20) ^ tv.tv_usec ^
+		       ((uint64_t)getpid() << 40);
 	}
-	SetSeed(seed);
+	if (fd != -1)
+		close(fd);
+	return seed;
+}
+
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/*
+ * seed one xoshiro256** stream; the same (seed, stream) pair always
+ * gives the same sequence
+ */
+void SetSeed(rnd_ctx_t *rnd, uint64_t seed, uint64_t stream)
+{
+	uint64_t x = seed ^ (stream * 0xd1342543de82ef95ULL);
+	int i;
+
+	for (i = 0; i < 4; i++)
+		rnd->s[i] = splitmix64(&x);
+}
+
+static inline uint64_t rotl(const uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+uint64_t rnd_next(rnd_ctx_t *rnd)
+{
+	uint64_t *s = rnd->s;
+	const uint64_t result = rotl(s[1] * 5, 7) * 9;
+	const uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+
+	return result;
 }
 
 /*
  * return number uniformly distributed b/w min and max, inclusive
  */
-int RandomNumber(int min, int max)
+int RandomNumber(rnd_ctx_t *rnd, int min, int max)
 {
-	return min + (rand() % ((max - min) + 1));
+	uint64_t range = (uint64_t)((int64_t)max - min) + 1;
+
+	/* multiply-shift, no division on the hot path */
+	return min + (int)(((rnd_next(rnd) >> 32) * range) >> 32);
 }
 
 /*
@@ -60,17 +102,44 @@ int RandomNumber(int min, int max)
  * value of C should be used for all calls with the same value of
  * A.  however, we know in advance which values of A will be used.
  */
-int NURand(unsigned A, unsigned x, unsigned y)
+void NURand_init(rnd_ctx_t *rnd, int run)
 {
-	static int first = 1;
-	unsigned C, C_255, C_1023, C_8191;
-
-	if (first) {
-		C_255 = RandomNumber(0, 255);
-		C_1023 = RandomNumber(0, 1023);
-		C_8191 = RandomNumber(0, 8191);
-		first = 0;
-	}
+	unsigned delta;
+
+	/* the load constants, the same for the same seed */
+	C_255 = C_255_load = RandomNumber(rnd, 0, 255);
+	C_1023 = RandomNumber(rnd, 0, 1023);
+	C_8191 = RandomNumber(rnd, 0, 8191);
+	if (!run)
+		return;
+
+	/*
+	 * 2.1.6.1: C_run of C_LAST differs from C_load by a delta in
+	 * 65..119, but not 96 or 112. either side fits for some C_load,
+	 * one of them always does.
+	 */
+	do {
+		delta = RandomNumber(rnd, 65, 119);
+	} while (delta == 96 || delta == 112);
+	if (C_255 + delta > 255 || (C_255 >= delta && RandomNumber(rnd, 0, 1)))
+		C_255 -= delta;
+	else
+		C_255 += delta;
+	C_1023 = RandomNumber(rnd, 0, 1023);
+	C_8191 = RandomNumber(rnd, 0, 8191);
+}
+
+/* the C in use for A; load: C_LAST of the loader instead */
+unsigned NURand_C(unsigned A, int load)
+{
+	if (load)
+		return C_255_load;
+	return A == 255 ? C_255 : A == 1023 ? C_1023 : C_8191;
+}
+
+int NURand(rnd_ctx_t *rnd, unsigned A, unsigned x, unsigned y)
+{
+	unsigned C;
 
 	switch (A) {
 	case 255:
@@ -87,7 +156,7 @@ int NURand(unsigned A, unsigned x, unsigned y)
 		abort();
 	}
 
-	return (int)(((RandomNumber(0, A) | RandomNumber(x, y)) + C) %
+	return (int)(((RandomNumber(rnd, 0, A) | RandomNumber(rnd, x, y)) + C) %
 		     (y - x + 1)) +
 	       x;
 }
@@ -99,7 +168,7 @@ int NURand(unsigned A, unsigned x, unsigned y)
  * characters of a random length of minimum x, maximum y, and
  * mean (y+x)/2
  */
-int MakeAlphaString(int x, int y, char str[])
+int MakeAlphaString(rnd_ctx_t *rnd, int x, int y, char str[])
 {
 	static char *alphanum = "0123456789"
 				"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
@@ -107,10 +176,10 @@ int MakeAlphaString(int x, int y, char str[])
 	int arrmax = 61; /* index of last array element */
 	register int i, len;
 
-	len = RandomNumber(x, y);
+	len = RandomNumber(rnd, x, y);
 
 	for (i = 0; i < len; i++)
-		str[i] = alphanum[RandomNumber(0, arrmax)];
+		str[i] = alphanum[RandomNumber(rnd, 0, arrmax)];
 
 	return len;
 }
@@ -118,16 +187,16 @@ int MakeAlphaString(int x, int y, char str[])
 /*
  * like MakeAlphaString, only numeric characters only
  */
-int MakeNumberString(int x, int y, char str[])
+int MakeNumberString(rnd_ctx_t *rnd, int x, int y, char str[])
 {
 	static char *numeric = "0123456789";
 	int arrmax = 9;
 	register int i, len;
 
-	len = RandomNumber(x, y);
+	len = RandomNumber(rnd, x, y);
 
 	for (i = 0; i < len; i++)
-		str[i] = numeric[RandomNumber(0, arrmax)];
+		str[i] = numeric[RandomNumber(rnd, 0, arrmax)];
 
 	return len;
 }
@@ -154,7 +223,7 @@ void gettimestamp(char str[], char *format, size_t len)
 /*
  * permute the list of customer ids for the order table
  */
-void InitPermutation(void)
+void InitPermutation(rnd_ctx_t *rnd)
 {
 	int *cur;
 	int i, j;
@@ -168,7 +237,7 @@ void InitPermutation(void)
 
 	/* now, shuffle */
 	for (i = 0; i < ORD_PER_DIST - 1; i++) {
-		j = (int)RandomNumber(i + 1, ORD_PER_DIST - 1);
+		j = (int)RandomNumber(rnd, i + 1, ORD_PER_DIST - 1);
 		swap_int(nums[i], nums[j]);
 	}
 }
@@ -0,0 +1,179 @@
+/*
+ * terminal.c
+ * emulated TPC-C terminals (keying time, think time, scheduling)
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "tpc.h"
+#include "trans_if.h"
+#include "terminal.h"
+
+/* 5.2.5.7: minimum keying time and mean think time, in sec. */
+static const double keying_time[TX_NUMS] = { 18.0, 3.0, 2.0, 2.0, 2.0 };
+static const double think_time[TX_NUMS] = { 12.0, 12.0, 10.0, 5.0, 5.0 };
+
+/* 1.0 runs at spec speed, smaller values compress all waits */
+double term_time_scale = 1.0;
+
+/* negative exponential, truncated at 10 times the mean */
+static double think(rnd_ctx_t *rnd, int tx)
+{
+	double mean = think_time[tx];
+	double u = ((rnd_next(rnd) >> 11) + 1) * (1.0 / 9007199254740992.0);
+	double t = -log(u) * mean;
+
+	return t > 10.0 * mean ? 10.0 * mean : t;
+}
+
+static inline uint64_t to_tick(term_sched_t *s, double t)
+{
+	return t <= s->origin ? 0 : (uint64_t)((t - s->origin) / WHEEL_TICK);
+}
+
+static void ready_append(term_sched_t *s, terminal_t *t)
+{
+	t->next = NULL;
+	if (s->ready_tail)
+		s->ready_tail->next = t;
+	else
+		s->ready_head = t;
+	s->ready_tail = t;
+}
+
+void term_sched_add(term_sched_t *s, terminal_t *t)
+{
+	terminal_t **slot;
+
+	t->due_tick = to_tick(s, t->due);
+	if (t->due_tick <= s->tick) {
+		ready_append(s, t);
+		return;
+	}
+	slot = &s->slot[t->due_tick % WHEEL_SLOTS];
+	t->next = *slot;
+	*slot = t;
+}
+
+/* move everything due up to tick now_tick onto the ready list */
+static void expire(term_sched_t *s, uint64_t now_tick)
+{
+	uint64_t tick, last;
+	terminal_t **pp, *t;
+
+	if (now_tick <= s->tick)
+		return;
+	/* a full lap visits every slot once */
+	last = now_tick - s->tick > WHEEL_SLOTS ? s->tick + WHEEL_SLOTS :
+						   now_tick;
+	for (tick = s->tick + 1; tick <= last; tick++) {
+		pp = &s->slot[tick % WHEEL_SLOTS];
+		while ((t = *pp) != NULL) {
+			if (t->due_tick <= now_tick) {
+				*pp = t->next;
+				ready_append(s, t);
+			} else {
+				pp = &t->next;
+			}
+		}
+	}
+	s->tick = now_tick;
+}
+
+terminal_t *term_sched_next(term_sched_t *s, double now, double *wake)
+{
+	terminal_t *t;
+	uint64_t tick;
+
+	expire(s, to_tick(s, now));
+	if ((t = s->ready_head) != NULL) {
+		s->ready_head = t->next;
+		if (s->ready_head == NULL)
+			s->ready_tail = NULL;
+		return t;
+	}
+
+	/* sleep until the next occupied slot, at most one lap */
+	for (tick = s->tick + 1; tick <= s->tick + WHEEL_SLOTS; tick++) {
+		if (s->slot[tick % WHEEL_SLOTS])
+			break;
+	}
+	*wake = s->origin + tick * WHEEL_TICK;
+	return NULL;
+}
+
+/*
+ * the keying time runs from the end of the think time (t->due), not
+ * from when the worker got round to it, so a lagging worker shows up as
+ * latency instead of being dropped from the schedule
+ */
+void term_key_next(terminal_t *t, thread_arg *arg, int t_num)
+{
+	int tx = seq_get(t->deck);
+
+	tx_input_gen(arg, t_num, tx, t->w_id, t->d_id, &t->input);
+	t->state = TERM_KEYING;
+	t->due += keying_time[tx] * term_time_scale;
+}
+
+void term_think(terminal_t *t, rnd_ctx_t *rnd, double now)
+{
+	t->state = TERM_THINKING;
+	t->due = now + think(rnd, t->input.tx) * term_time_scale;
+}
+
+/*
+ * the terminals of the thread's home warehouses are numbered
+ * 0..nterms-1 (10 per warehouse, one per district); the threads of an
+ * affinity group share them, each taking every group_size-th one
+ */
+term_sched_t *term_sched_new(thread_arg *arg, int t_num, double start)
+{
+	int worker = arg->aff.rank;
+	int nworkers = arg->aff.group_size;
+	int nterms = (arg->aff.w_hi - arg->aff.w_lo + 1) * TERMINALS_PER_WARE;
+	term_sched_t *s;
+	terminal_t *t;
+	int i;
+
+	s = calloc(1, sizeof(term_sched_t));
+	if (s == NULL)
+		return NULL;
+	s->origin = start;
+	s->terms = calloc(nterms / nworkers + 1, sizeof(terminal_t));
+	if (s->terms == NULL) {
+		free(s);
+		return NULL;
+	}
+
+	for (i = worker; i < nterms; i += nworkers) {
+		t = &s->terms[s->count];
+		t->w_id = arg->aff.w_lo + i / TERMINALS_PER_WARE;
+		t->d_id = i % TERMINALS_PER_WARE + 1;
+		t->deck = seq_deck_new(&arg->rnd);
+		if (t->deck == NULL) {
+			term_sched_free(s);
+			return NULL;
+		}
+		s->count++;
+		/* stagger the first submissions over one keying time */
+		t->due = start;
+		term_key_next(t, arg, t_num);
+		t->due = start + (t->due - start) *
+					 RandomNumber(&arg->rnd, 0, 1000) /
+					 1000.0;
+		term_sched_add(s, t);
+	}
+	return s;
+}
+
+void term_sched_free(term_sched_t *s)
+{
+	int i;
+
+	for (i = 0; i < s->count; i++)
+		seq_deck_free(s->terms[i].deck);
+	free(s->terms);
+	free(s);
+}
@@ -0,0 +1,77 @@
+/*
+ * terminal.h
+ * emulated TPC-C terminals (keying time, think time, scheduling)
+ */
+
+#ifndef _TPCC_TERMINAL_H_
+#define _TPCC_TERMINAL_H_
+
+#include <stdint.h>
+
+#include "main.h"
+#include "sequence.h"
+
+#define TERMINALS_PER_WARE 10
+
+/*
+ * A terminal is a small state machine parked in its worker's timer
+ * wheel between steps:
+ *   TERM_KEYING:   input generated, due when keying time is over
+ *                  -> run the tx on the worker's connection
+ *   TERM_THINKING: due when think time is over
+ *                  -> pick the next tx, generate its input, key it in
+ */
+enum term_state {
+	TERM_KEYING,
+	TERM_THINKING
+};
+
+typedef struct terminal {
+	struct terminal *next; /* wheel slot / ready list */
+	double due; /* CLOCK_MONOTONIC sec. */
+	uint64_t due_tick;
+	int w_id;
+	int d_id;
+	int state;
+	seq_deck_t *deck; /* the mix is kept per terminal */
+	tx_input_t input;
+} terminal_t;
+
+/*
+ * Per-worker hashed timer wheel with 1ms ticks. Terminals due in the
+ * same slot but a later lap stay put until their own tick comes round.
+ */
+#define WHEEL_SLOTS 4096
+#define WHEEL_TICK 0.001 /* sec. */
+
+typedef struct term_sched {
+	terminal_t *terms;
+	int count; /* terminals owned */
+	double origin; /* sec. of tick 0 */
+	uint64_t tick; /* every slot up to this tick has been expired */
+	terminal_t *ready_head; /* due, in expiry order */
+	terminal_t *ready_tail;
+	terminal_t *slot[WHEEL_SLOTS];
+} term_sched_t;
+
+extern double term_time_scale;
+
+term_sched_t *term_sched_new(thread_arg *arg, int t_num, double start);
+void term_sched_free(term_sched_t *s);
+
+/* park t until t->due */
+void term_sched_add(term_sched_t *s, terminal_t *t);
+
+/*
+ * next terminal due by now, or NULL with *wake set to when to look
+ * again
+ */
+terminal_t *term_sched_next(term_sched_t *s, double now, double *wake);
+
+/* TERM_THINKING is over: choose, generate and start keying the next tx */
+void term_key_next(terminal_t *t, thread_arg *arg, int t_num);
+
+/* the tx is done at now: start thinking */
+void term_think(terminal_t *t, rnd_ctx_t *rnd, double now);
+
+#endif
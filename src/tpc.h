@@ -3,6 +3,11 @@
  * definitions for tpcc loading program && transactions
  */
 
+#ifndef _TPCC_TPC_H_
+#define _TPCC_TPC_H_
+
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -39,40 +44,45 @@ extern "C" {
 		b = tmp; \
 	}
 
+/* xoshiro256** state, one per thread */
+typedef struct rnd_ctx {
+	uint64_t s[4];
+} rnd_ctx_t;
+
 /*
  * hack MakeAddress() into a macro so that we can pass Oracle
  * VARCHARs instead of char *s
  */
-#define MakeAddressMacro(str1, str2, city, state, zip)   \
-	{                                                \
-		int tmp;                                 \
-		tmp = MakeAlphaString(10, 20, str1.arr); \
-		str1.len = tmp;                          \
-		tmp = MakeAlphaString(10, 20, str2.arr); \
-		str2.len = tmp;                          \
-		tmp = MakeAlphaString(10, 20, city.arr); \
-		city.len = tmp;                          \
-		tmp = MakeAlphaString(2, 2, state.arr);  \
-		state.len = tmp;                         \
-		tmp = MakeNumberString(9, 9, zip.arr);   \
-		zip.len = tmp;                           \
+#define MakeAddressMacro(rnd, str1, str2, city, state, zip) \
+	{                                                       \
+		int tmp;                                        \
+		tmp = MakeAlphaString(rnd, 10, 20, str1.arr);   \
+		str1.len = tmp;                                 \
+		tmp = MakeAlphaString(rnd, 10, 20, str2.arr);   \
+		str2.len = tmp;                                 \
+		tmp = MakeAlphaString(rnd, 10, 20, city.arr);   \
+		city.len = tmp;                                 \
+		tmp = MakeAlphaString(rnd, 2, 2, state.arr);    \
+		state.len = tmp;                                \
+		tmp = MakeNumberString(rnd, 9, 9, zip.arr);     \
+		zip.len = tmp;                                  \
 	}
 
 /*
  * while we're at it, wrap MakeAlphaString() and MakeNumberString()
  * in a similar way
  */
-#define MakeAlphaStringMacro(x, y, str)               \
-	{                                             \
-		int tmp;                              \
-		tmp = MakeAlphaString(x, y, str.arr); \
-		str.len = tmp;                        \
+#define MakeAlphaStringMacro(rnd, x, y, str)               \
+	{                                                  \
+		int tmp;                                   \
+		tmp = MakeAlphaString(rnd, x, y, str.arr); \
+		str.len = tmp;                             \
 	}
-#define MakeNumberStringMacro(x, y, str)               \
-	{                                              \
-		int tmp;                               \
-		tmp = MakeNumberString(x, y, str.arr); \
-		str.len = tmp;                         \
+#define MakeNumberStringMacro(rnd, x, y, str)               \
+	{                                                   \
+		int tmp;                                    \
+		tmp = MakeNumberString(rnd, x, y, str.arr); \
+		str.len = tmp;                              \
 	}
 
 /*
@@ -102,16 +112,19 @@ void New_Orders();
 void MakeAddress();
 void Error();
 
-void init_randomness();
+uint64_t init_randomness();
 
 #ifdef __STDC__
-void SetSeed(int seed);
-int RandomNumber(int min, int max);
-int NURand(unsigned A, unsigned x, unsigned y);
-int MakeAlphaString(int x, int y, char str[]);
-int MakeNumberString(int x, int y, char str[]);
+void SetSeed(rnd_ctx_t *rnd, uint64_t seed, uint64_t stream);
+uint64_t rnd_next(rnd_ctx_t *rnd);
+int RandomNumber(rnd_ctx_t *rnd, int min, int max);
+void NURand_init(rnd_ctx_t *rnd, int run);
+unsigned NURand_C(unsigned A, int load);
+int NURand(rnd_ctx_t *rnd, unsigned A, unsigned x, unsigned y);
+int MakeAlphaString(rnd_ctx_t *rnd, int x, int y, char str[]);
+int MakeNumberString(rnd_ctx_t *rnd, int x, int y, char str[]);
 void gettimestamp(char str[], char *format, size_t n);
-void InitPermutation(void);
+void InitPermutation(rnd_ctx_t *rnd);
 int GetPermutation(void);
 void Lastname(int num, char *name);
 
@@ -120,3 +133,5 @@ void Lastname(int num, char *name);
 #ifdef __cplusplus
 }
 #endif
+
+#endif
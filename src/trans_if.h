@@ -9,13 +9,26 @@ extern "C" {
 #endif
 
 #include "main.h"
-int driver(int t_num, thread_arg *arg);
+#include "remote.h"
+void tx_input_gen(thread_arg *arg, int t_num, int tx, int home_w_id,
+		  int home_d_id, tx_input_t *in);
+int tx_execute(int t_num, thread_arg *arg, tx_input_t *in);
+int tx_run(int t_num, thread_arg *arg, tx_input_t *in);
+int tx_ctl_prepare(thread_arg *arg);
+void tx_ctl_finalize(thread_arg *arg);
+int tx_write_shards(const tx_input_t *in, int *ks);
+int tx_ctl(thread_arg *arg, int ctl);
+void tx_abort_stmts(sqlite3 *db);
+int begin_mode_parse(const char *spec);
+const char *begin_mode_name(int mode);
 int neword(int t_num, thread_arg *arg, int w_id_arg, int d_id_arg, int c_id_arg,
 	   int o_ol_cnt_arg, int o_all_local_arg, int itemid[], int supware[],
 	   int qty[]);
+int neword_stock(int t_num, thread_arg *arg, remote_stock_t *rs);
 int payment(int t_num, thread_arg *arg, int w_id_arg, int d_id_arg, int byname, int c_w_id_arg,
 	    int c_d_id_arg, int c_id_arg, char c_last_arg[],
 	    float h_amount_arg);
+int payment_customer(int t_num, thread_arg *arg, remote_cust_t *pc);
 int ordstat(int t_num, thread_arg *arg, int w_id, int d_id, int byname, int c_id, char c_last[]);
 int slev(int t_num, thread_arg *arg, int w_id, int d_id, int level);
 int delivery(int t_num, thread_arg *arg, int w_id_arg, int o_carrier_id_arg);
@@ -0,0 +1,151 @@
+/*
+ * txphase.c
+ * latency breakdown of each tx type by phase
+ *
+ * Each thread records into its own histograms, one per tx type and
+ * phase slot in use (see hdr_hist.c); the reporter merges them once the
+ * threads are done. Only committed txs of the measurement window count.
+ * The clock also runs without the histograms, for the slow tx log.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hdr_hist.h"
+#include "txphase.h"
+
+#define MAX_PHASE_USEC (3600LL * 1000000) /* 1 hour */
+#define SIGNIFICANT_FIGURES 2
+
+extern const char *tx_name[];
+
+int txphase_on = 0;
+
+/* NULL: slot not used by that tx type */
+static const char *phase_name[TX_NUMS][TX_PHASES] = {
+	[TX_NEWORD] = { "begin", "cust+ware", "district", "order", "item",
+			"stock", "order_line", "commit" },
+	[TX_PAYMENT] = { "begin", "warehouse", "district", "customer",
+			 "history", NULL, NULL, "commit" },
+	[TX_ORDSTAT] = { "begin", "customer", "order", "lines", NULL, NULL,
+			 NULL, "commit" },
+	[TX_DELIVERY] = { "begin", "new_orders", "orders", "order_line",
+			  "customer", NULL, NULL, "commit" },
+	[TX_SLEV] = { "begin", "district", "stock", NULL, NULL, NULL, NULL,
+		      "commit" },
+};
+
+static int num_shards;
+static hdr_hist_t *shards; /* [num_shards][TX_NUMS][TX_PHASES] */
+
+static hdr_hist_t *shard_of_phase(int t, int tx, int p)
+{
+	return &shards[(t * TX_NUMS + tx) * TX_PHASES + p];
+}
+
+int txphase_init(int nthreads)
+{
+	int t, tx, p;
+
+	num_shards = nthreads;
+	shards = calloc((size_t)nthreads * TX_NUMS * TX_PHASES,
+			sizeof(hdr_hist_t));
+	if (shards == NULL)
+		return 1;
+	for (t = 0; t < nthreads; t++) {
+		for (tx = 0; tx < TX_NUMS; tx++) {
+			for (p = 0; p < TX_PHASES; p++) {
+				if (phase_name[tx][p] == NULL)
+					continue;
+				if (hdr_hist_init(shard_of_phase(t, tx, p),
+						  MAX_PHASE_USEC,
+						  SIGNIFICANT_FIGURES))
+					return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+void txphase_done(void)
+{
+	int i;
+
+	if (shards == NULL)
+		return;
+	for (i = 0; i < num_shards * TX_NUMS * TX_PHASES; i++)
+		hdr_hist_done(&shards[i]);
+	free(shards);
+	shards = NULL;
+	num_shards = 0;
+}
+
+/* name of phase slot p of tx, NULL when tx does not use it */
+const char *txphase_name(int tx, int p)
+{
+	return phase_name[tx][p];
+}
+
+/*
+ * close the attempt; with the histograms (-E) a committed one is
+ * recorded phase by phase. the times stay in arg->txp.
+ */
+void txphase_end(thread_arg *arg, int ok)
+{
+	tx_clock_t *c = &arg->txp;
+	int p;
+
+	if (!txphase_on || c->tx < 0)
+		return;
+	c->ns[c->cur] += txphase_now() - c->t0;
+	if (ok && shards && get_phase() == PHASE_MEASURE) {
+		for (p = 0; p < TX_PHASES; p++) {
+			if ((c->seen & (1u << p)) && phase_name[c->tx][p])
+				hdr_hist_record(shard_of_phase(arg->number,
+							       c->tx, p),
+						(c->ns[p] + 500) / 1000);
+		}
+	}
+	c->tx = -1;
+}
+
+void txphase_report(void)
+{
+	hdr_hist_t h[TX_PHASES];
+	double sum[TX_PHASES], total;
+	int t, tx, p;
+
+	printf("\n<Phase Breakdown (msec.)> (committed txs; share: of the time spent in the tx)\n");
+	printf("                            p50       p95       p99     p99.9       max  share\n");
+	for (tx = 0; tx < TX_NUMS; tx++) {
+		total = 0.0;
+		for (p = 0; p < TX_PHASES; p++) {
+			if (phase_name[tx][p] == NULL)
+				continue;
+			if (hdr_hist_init(&h[p], MAX_PHASE_USEC,
+					  SIGNIFICANT_FIGURES))
+				return;
+			for (t = 0; t < num_shards; t++) {
+				hdr_hist_recount(shard_of_phase(t, tx, p));
+				hdr_hist_add(&h[p], shard_of_phase(t, tx, p));
+			}
+			sum[p] = hdr_hist_mean(&h[p]) * h[p].total_count;
+			total += sum[p];
+		}
+		printf("%12s :\n", tx_name[tx]);
+		for (p = 0; p < TX_PHASES; p++) {
+			if (phase_name[tx][p] == NULL)
+				continue;
+			printf("    %12s : %9.3f %9.3f %9.3f %9.3f %9.3f %5.1f%%\n",
+			       phase_name[tx][p],
+			       hdr_hist_value_at_percentile(&h[p], 50.0) / 1000.0,
+			       hdr_hist_value_at_percentile(&h[p], 95.0) / 1000.0,
+			       hdr_hist_value_at_percentile(&h[p], 99.0) / 1000.0,
+			       hdr_hist_value_at_percentile(&h[p], 99.9) / 1000.0,
+			       hdr_hist_max(&h[p]) / 1000.0,
+			       total > 0.0 ? 100.0 * sum[p] / total : 0.0);
+			hdr_hist_done(&h[p]);
+		}
+	}
+}
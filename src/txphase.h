@@ -0,0 +1,105 @@
+/*
+ * txphase.h
+ * latency breakdown of each tx type by phase
+ *
+ * With -E an attempt is split into phases: the BEGIN (admission queue
+ * and write lock included), the groups of statements the tx functions
+ * mark as they go, and the COMMIT. The time of every phase of each
+ * committed tx is recorded in a per-thread histogram, so a tail in the
+ * response times can be put down to the district row, the stock
+ * updates or the commit.
+ */
+
+#ifndef _TPCC_TXPHASE_H_
+#define _TPCC_TXPHASE_H_
+
+#include "main.h"
+
+/* phase slots, shared by all tx types; a tx uses some of them */
+enum txp_slot {
+	TXP_BEGIN,
+	TXP_BODY1,
+	TXP_BODY2,
+	TXP_BODY3,
+	TXP_BODY4,
+	TXP_BODY5,
+	TXP_BODY6,
+	TXP_COMMIT = TX_PHASES - 1
+};
+
+/* New-Order */
+#define TXP_NO_CUSTWARE TXP_BODY1 /* customer and warehouse read */
+#define TXP_NO_DISTRICT TXP_BODY2 /* d_next_o_id read and update */
+#define TXP_NO_ORDER TXP_BODY3 /* orders and new_orders inserts */
+/* per line, summed over the lines */
+#define TXP_NO_ITEM TXP_BODY4 /* item read */
+#define TXP_NO_STOCK TXP_BODY5 /* stock read and update */
+#define TXP_NO_ORDERLINE TXP_BODY6 /* order_line insert */
+/* Payment */
+#define TXP_PY_WAREHOUSE TXP_BODY1
+#define TXP_PY_DISTRICT TXP_BODY2
+#define TXP_PY_CUSTOMER TXP_BODY3
+#define TXP_PY_HISTORY TXP_BODY4
+/* Order-Status */
+#define TXP_OS_CUSTOMER TXP_BODY1
+#define TXP_OS_ORDER TXP_BODY2
+#define TXP_OS_LINES TXP_BODY3
+/* Delivery, summed over the districts */
+#define TXP_DL_NEWORDER TXP_BODY1
+#define TXP_DL_ORDER TXP_BODY2
+#define TXP_DL_LINES TXP_BODY3
+#define TXP_DL_CUSTOMER TXP_BODY4
+/* Stock-Level */
+#define TXP_SL_DISTRICT TXP_BODY1
+#define TXP_SL_STOCK TXP_BODY2
+
+extern int txphase_on; /* the clock runs */
+
+int txphase_init(int nthreads);
+void txphase_done(void);
+void txphase_end(thread_arg *arg, int ok);
+const char *txphase_name(int tx, int p);
+void txphase_report(void);
+
+static inline int64_t txphase_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* start timing an attempt of tx, in its BEGIN phase */
+static inline void txphase_begin(thread_arg *arg, int tx)
+{
+	tx_clock_t *c = &arg->txp;
+	int i;
+
+	if (!txphase_on) {
+		c->tx = -1;
+		return;
+	}
+	c->tx = tx;
+	c->cur = TXP_BEGIN;
+	c->seen = 1u << TXP_BEGIN;
+	for (i = 0; i < TX_PHASES; i++)
+		c->ns[i] = 0;
+	c->t0 = txphase_now();
+}
+
+/* close the current phase and go on with phase p */
+static inline void txphase_mark(thread_arg *arg, int p)
+{
+	tx_clock_t *c = &arg->txp;
+	int64_t now;
+
+	if (!txphase_on || c->tx < 0 || c->cur == p)
+		return;
+	now = txphase_now();
+	c->ns[c->cur] += now - c->t0;
+	c->cur = p;
+	c->seen |= 1u << p;
+	c->t0 = now;
+}
+
+#endif